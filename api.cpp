@@ -1,5 +1,8 @@
 #include "./api.h"
 
+#include "./message.h"
+#include "./message_cache.h"
+
 using namespace std;
 
 namespace cq::api {
@@ -17,6 +20,25 @@ namespace cq::api {
         }
     }
 
+    Result<int64_t> try_send_msg(const Target &target, const string &msg) {
+        if (const auto coalescer = message::SendCoalescer::current(); coalescer && coalescer->buffer(target, msg)) {
+            return 0;
+        }
+
+        auto message_id = Result<int64_t>::error(exception::ApiError::INVALID_TARGET);
+        if (target.group_id.has_value()) {
+            message_id = try_send_group_msg(target.group_id.value(), msg);
+        } else if (target.discuss_id.has_value()) {
+            message_id = try_send_discuss_msg(target.discuss_id.value(), msg);
+        } else if (target.user_id.has_value()) {
+            message_id = try_send_private_msg(target.user_id.value(), msg);
+        }
+        if (message_id) {
+            message_cache.record_outgoing(target, *message_id, msg);
+        }
+        return message_id;
+    }
+
     namespace raw {
 #define FUNC(ReturnType, FuncName, ...)                                                              \
     typedef __declspec(dllimport) ReturnType(__stdcall *__CQ_##FuncName##_T)(__VA_ARGS__);           \
@@ -5,6 +5,7 @@
 #include "./app.h"
 #include "./enums.h"
 #include "./target.h"
+#include "./trace.h"
 #include "./types.h"
 #include "./utils/string.h"
 
@@ -44,211 +45,455 @@ namespace cq::api {
         }
     }
 
+    /**
+     * The result of a try_* API function: either a value, or the error code that the throwing
+     * version would put in exception::ApiError, i.e. the raw CoolQ error code, or ApiError::INVALID_DATA.
+     */
+    template <typename T>
+    class Result {
+    public:
+        Result(T value) : value_(std::move(value)) {}
+
+        static Result error(const int code) {
+            Result result;
+            result.code_ = code;
+            return result;
+        }
+
+        bool ok() const noexcept { return value_.has_value(); }
+        explicit operator bool() const noexcept { return ok(); }
+
+        /**
+         * The error code, or 0 if succeeded.
+         */
+        int code() const noexcept { return code_; }
+
+        /**
+         * Get the value, or throw exception::ApiError if failed.
+         */
+        T &value() & noexcept(false) {
+            if (!ok()) {
+                throw exception::ApiError(code_);
+            }
+            return *value_;
+        }
+
+        T &&value() && noexcept(false) { return std::move(value()); }
+
+        T value_or(T default_value) const & { return ok() ? *value_ : std::move(default_value); }
+
+        T &operator*() & noexcept { return *value_; }
+        const T &operator*() const & noexcept { return *value_; }
+        T *operator->() noexcept { return &*value_; }
+        const T *operator->() const noexcept { return &*value_; }
+
+    private:
+        Result() = default;
+
+        std::optional<T> value_;
+        int code_ = 0;
+    };
+
+    template <>
+    class Result<void> {
+    public:
+        Result() = default;
+
+        static Result error(const int code) {
+            Result result;
+            result.code_ = code;
+            return result;
+        }
+
+        bool ok() const noexcept { return code_ == 0; }
+        explicit operator bool() const noexcept { return ok(); }
+        int code() const noexcept { return code_; }
+
+        void value() const noexcept(false) {
+            if (!ok()) {
+                throw exception::ApiError(code_);
+            }
+        }
+
+    private:
+        int code_ = 0;
+    };
+
+    inline Result<void> __result(const int32_t ret) noexcept {
+        return ret < 0 ? Result<void>::error(ret) : Result<void>();
+    }
+
+    inline Result<int64_t> __id_result(const int32_t ret) noexcept {
+        return ret < 0 ? Result<int64_t>::error(ret) : Result<int64_t>(ret);
+    }
+
+    inline Result<std::string> __string_result(const char *const ret) {
+        if (!ret) {
+            return Result<std::string>::error(exception::ApiError::INVALID_DATA);
+        }
+        return utils::string_from_coolq(ret);
+    }
+
+    template <typename T>
+    Result<T> __object_result(const Result<std::string> &b64) {
+        if (!b64) {
+            return Result<T>::error(b64.code());
+        }
+        T object;
+        if (!ObjectHelper::try_from_base64(*b64, object)) {
+            return Result<T>::error(exception::ApiError::INVALID_DATA);
+        }
+        return object;
+    }
+
+    template <typename Container>
+    Result<Container> __objects_result(const Result<std::string> &b64) {
+        if (!b64) {
+            return Result<Container>::error(b64.code());
+        }
+        Container objects;
+        if (!ObjectHelper::try_multi_from_base64(*b64, objects)) {
+            return Result<Container>::error(exception::ApiError::INVALID_DATA);
+        }
+        return objects;
+    }
+
+    /*
+     * Each API function has a try_* version, which never throws exception::ApiError, and returns a Result instead.
+     * This is cheaper on paths where failures are common, e.g. sending to a group where we are muted.
+     */
+
 #pragma region Message
 
+    inline Result<int64_t> try_send_private_msg(const int64_t user_id, const std::string &msg) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __id_result(raw::CQ_sendPrivateMsg(app::auth_code, user_id, utils::string_to_coolq_arg(msg)));
+    }
+
+    inline Result<int64_t> try_send_group_msg(const int64_t group_id, const std::string &msg) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __id_result(raw::CQ_sendGroupMsg(app::auth_code, group_id, utils::string_to_coolq_arg(msg)));
+    }
+
+    inline Result<int64_t> try_send_discuss_msg(const int64_t discuss_id, const std::string &msg) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __id_result(raw::CQ_sendDiscussMsg(app::auth_code, discuss_id, utils::string_to_coolq_arg(msg)));
+    }
+
+    inline Result<void> try_delete_msg(const int64_t msg_id) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_deleteMsg(app::auth_code, msg_id));
+    }
+
     inline int64_t send_private_msg(const int64_t user_id, const std::string &msg) noexcept(false) {
-        const auto ret = raw::CQ_sendPrivateMsg(app::auth_code, user_id, utils::string_to_coolq(msg).c_str());
-        __throw_if_needed(ret);
-        return ret;
+        return try_send_private_msg(user_id, msg).value();
     }
 
     inline int64_t send_group_msg(const int64_t group_id, const std::string &msg) noexcept(false) {
-        const auto ret = raw::CQ_sendGroupMsg(app::auth_code, group_id, utils::string_to_coolq(msg).c_str());
-        __throw_if_needed(ret);
-        return ret;
+        return try_send_group_msg(group_id, msg).value();
     }
 
     inline int64_t send_discuss_msg(const int64_t discuss_id, const std::string &msg) noexcept(false) {
-        const auto ret = raw::CQ_sendDiscussMsg(app::auth_code, discuss_id, utils::string_to_coolq(msg).c_str());
-        __throw_if_needed(ret);
-        return ret;
+        return try_send_discuss_msg(discuss_id, msg).value();
     }
 
-    inline void delete_msg(const int64_t msg_id) noexcept(false) {
-        __throw_if_needed(raw::CQ_deleteMsg(app::auth_code, msg_id));
-    }
+    inline void delete_msg(const int64_t msg_id) noexcept(false) { try_delete_msg(msg_id).value(); }
 
 #pragma endregion
 
 #pragma region Send Like
 
-    inline void send_like(const int64_t user_id) noexcept(false) {
-        __throw_if_needed(raw::CQ_sendLike(app::auth_code, user_id));
+    inline Result<void> try_send_like(const int64_t user_id) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_sendLike(app::auth_code, user_id));
     }
 
+    inline Result<void> try_send_like(const int64_t user_id, const int32_t times) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_sendLikeV2(app::auth_code, user_id, times));
+    }
+
+    inline void send_like(const int64_t user_id) noexcept(false) { try_send_like(user_id).value(); }
+
     inline void send_like(const int64_t user_id, const int32_t times) noexcept(false) {
-        __throw_if_needed(raw::CQ_sendLikeV2(app::auth_code, user_id, times));
+        try_send_like(user_id, times).value();
     }
 
 #pragma endregion
 
 #pragma region Group &Discuss Operation
 
+    inline Result<void> try_set_group_kick(const int64_t group_id, const int64_t user_id,
+                                           const bool reject_add_request) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setGroupKick(app::auth_code, group_id, user_id, reject_add_request));
+    }
+
+    inline Result<void> try_set_group_ban(const int64_t group_id, const int64_t user_id, const int64_t duration) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setGroupBan(app::auth_code, group_id, user_id, duration));
+    }
+
+    inline Result<void> try_set_group_anonymous_ban(const int64_t group_id, const std::string &flag,
+                                                    const int64_t duration) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(
+            raw::CQ_setGroupAnonymousBan(app::auth_code, group_id, utils::string_to_coolq_arg(flag), duration));
+    }
+
+    inline Result<void> try_set_group_whole_ban(const int64_t group_id, const bool enable) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setGroupWholeBan(app::auth_code, group_id, enable));
+    }
+
+    inline Result<void> try_set_group_admin(const int64_t group_id, const int64_t user_id, const bool enable) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setGroupAdmin(app::auth_code, group_id, user_id, enable));
+    }
+
+    inline Result<void> try_set_group_anonymous(const int64_t group_id, const bool enable) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setGroupAnonymous(app::auth_code, group_id, enable));
+    }
+
+    inline Result<void> try_set_group_card(const int64_t group_id, const int64_t user_id, const std::string &card) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setGroupCard(app::auth_code, group_id, user_id, utils::string_to_coolq_arg(card)));
+    }
+
+    inline Result<void> try_set_group_leave(const int64_t group_id, const bool is_dismiss) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setGroupLeave(app::auth_code, group_id, is_dismiss));
+    }
+
+    inline Result<void> try_set_group_special_title(const int64_t group_id, const int64_t user_id,
+                                                    const std::string &special_title, const int64_t duration) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setGroupSpecialTitle(
+            app::auth_code, group_id, user_id, utils::string_to_coolq_arg(special_title), duration));
+    }
+
+    inline Result<void> try_set_discuss_leave(const int64_t discuss_id) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setDiscussLeave(app::auth_code, discuss_id));
+    }
+
     inline void set_group_kick(const int64_t group_id, const int64_t user_id,
                                const bool reject_add_request) noexcept(false) {
-        __throw_if_needed(raw::CQ_setGroupKick(app::auth_code, group_id, user_id, reject_add_request));
+        try_set_group_kick(group_id, user_id, reject_add_request).value();
     }
 
     inline void set_group_ban(const int64_t group_id, const int64_t user_id, const int64_t duration) noexcept(false) {
-        __throw_if_needed(raw::CQ_setGroupBan(app::auth_code, group_id, user_id, duration));
+        try_set_group_ban(group_id, user_id, duration).value();
     }
 
     inline void set_group_anonymous_ban(const int64_t group_id, const std::string &flag,
                                         const int64_t duration) noexcept(false) {
-        __throw_if_needed(
-            raw::CQ_setGroupAnonymousBan(app::auth_code, group_id, utils::string_to_coolq(flag).c_str(), duration));
+        try_set_group_anonymous_ban(group_id, flag, duration).value();
     }
 
     inline void set_group_whole_ban(const int64_t group_id, const bool enable) noexcept(false) {
-        __throw_if_needed(raw::CQ_setGroupWholeBan(app::auth_code, group_id, enable));
+        try_set_group_whole_ban(group_id, enable).value();
     }
 
     inline void set_group_admin(const int64_t group_id, const int64_t user_id, const bool enable) noexcept(false) {
-        __throw_if_needed(raw::CQ_setGroupAdmin(app::auth_code, group_id, user_id, enable));
+        try_set_group_admin(group_id, user_id, enable).value();
     }
 
     inline void set_group_anonymous(const int64_t group_id, const bool enable) noexcept(false) {
-        __throw_if_needed(raw::CQ_setGroupAnonymous(app::auth_code, group_id, enable));
+        try_set_group_anonymous(group_id, enable).value();
     }
 
     inline void set_group_card(const int64_t group_id, const int64_t user_id, const std::string &card) noexcept(false) {
-        __throw_if_needed(
-            raw::CQ_setGroupCard(app::auth_code, group_id, user_id, utils::string_to_coolq(card).c_str()));
+        try_set_group_card(group_id, user_id, card).value();
     }
 
     inline void set_group_leave(const int64_t group_id, const bool is_dismiss) noexcept(false) {
-        __throw_if_needed(raw::CQ_setGroupLeave(app::auth_code, group_id, is_dismiss));
+        try_set_group_leave(group_id, is_dismiss).value();
     }
 
     inline void set_group_special_title(const int64_t group_id, const int64_t user_id, const std::string &special_title,
                                         const int64_t duration) noexcept(false) {
-        __throw_if_needed(raw::CQ_setGroupSpecialTitle(
-            app::auth_code, group_id, user_id, utils::string_to_coolq(special_title).c_str(), duration));
+        try_set_group_special_title(group_id, user_id, special_title, duration).value();
     }
 
-    inline void set_discuss_leave(const int64_t discuss_id) noexcept(false) {
-        __throw_if_needed(raw::CQ_setDiscussLeave(app::auth_code, discuss_id));
-    }
+    inline void set_discuss_leave(const int64_t discuss_id) noexcept(false) { try_set_discuss_leave(discuss_id).value(); }
 
 #pragma endregion
 
 #pragma region Request Operation
 
+    inline Result<void> try_set_friend_add_request(const std::string &flag, const request::Operation operation,
+                                                   const std::string &remark) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setFriendAddRequest(
+            app::auth_code, utils::string_to_coolq_arg(flag), operation, utils::string_to_coolq_arg(remark)));
+    }
+
+    inline Result<void> try_set_group_add_request(const std::string &flag, const request::SubType type,
+                                                  const request::Operation operation) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(
+            raw::CQ_setGroupAddRequest(app::auth_code, utils::string_to_coolq_arg(flag), type, operation));
+    }
+
+    inline Result<void> try_set_group_add_request(const std::string &flag, const request::SubType type,
+                                                  const request::Operation operation, const std::string &reason) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __result(raw::CQ_setGroupAddRequestV2(app::auth_code,
+                                                     utils::string_to_coolq_arg(flag),
+                                                     type,
+                                                     operation,
+                                                     utils::string_to_coolq_arg(reason)));
+    }
+
     inline void set_friend_add_request(const std::string &flag, const request::Operation operation,
                                        const std::string &remark) noexcept(false) {
-        __throw_if_needed(raw::CQ_setFriendAddRequest(
-            app::auth_code, utils::string_to_coolq(flag).c_str(), operation, utils::string_to_coolq(remark).c_str()));
+        try_set_friend_add_request(flag, operation, remark).value();
     }
 
     inline void set_group_add_request(const std::string &flag, const request::SubType type,
                                       const request::Operation operation) noexcept(false) {
-        __throw_if_needed(
-            raw::CQ_setGroupAddRequest(app::auth_code, utils::string_to_coolq(flag).c_str(), type, operation));
+        try_set_group_add_request(flag, type, operation).value();
     }
 
     inline void set_group_add_request(const std::string &flag, const request::SubType type,
                                       const request::Operation operation, const std::string &reason) noexcept(false) {
-        __throw_if_needed(raw::CQ_setGroupAddRequestV2(app::auth_code,
-                                                       utils::string_to_coolq(flag).c_str(),
-                                                       type,
-                                                       operation,
-                                                       utils::string_to_coolq(reason).c_str()));
+        try_set_group_add_request(flag, type, operation, reason).value();
     }
 
 #pragma endregion
 
 #pragma region Get QQ Information
 
-    inline int64_t get_login_user_id() noexcept { return raw::CQ_getLoginQQ(app::auth_code); }
+    inline int64_t get_login_user_id() noexcept {
+        CQ_TRACE_SPAN(API, __func__);
+        return raw::CQ_getLoginQQ(app::auth_code);
+    }
 
-    inline std::string get_login_nickname() noexcept(false) {
-        const auto ret = raw::CQ_getLoginNick(app::auth_code);
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+    inline Result<std::string> try_get_login_nickname() {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getLoginNick(app::auth_code));
     }
 
-    inline std::string get_stranger_info_base64(const int64_t user_id, const bool no_cache = false) noexcept(false) {
-        const auto ret = raw::CQ_getStrangerInfo(app::auth_code, user_id, no_cache);
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+    inline Result<std::string> try_get_stranger_info_base64(const int64_t user_id, const bool no_cache = false) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getStrangerInfo(app::auth_code, user_id, no_cache));
     }
 
-    inline std::string get_friend_list_base64() noexcept(false) {
-        const auto ret = raw::CQ_getFriendList(app::auth_code, false);
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+    inline Result<std::string> try_get_friend_list_base64() {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getFriendList(app::auth_code, false));
     }
 
-    inline std::string get_group_list_base64() noexcept(false) {
-        const auto ret = raw::CQ_getGroupList(app::auth_code);
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+    inline Result<std::string> try_get_group_list_base64() {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getGroupList(app::auth_code));
+    }
+
+    inline Result<std::string> try_get_group_info_base64(const int64_t group_id, const bool no_cache = false) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getGroupInfo(app::auth_code, group_id, no_cache));
     }
 
+    inline Result<std::string> try_get_group_member_list_base64(const int64_t group_id) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getGroupMemberList(app::auth_code, group_id));
+    }
+
+    inline Result<std::string> try_get_group_member_info_base64(const int64_t group_id, const int64_t user_id,
+                                                                const bool no_cache = false) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getGroupMemberInfoV2(app::auth_code, group_id, user_id, no_cache));
+    }
+
+    inline std::string get_login_nickname() noexcept(false) { return try_get_login_nickname().value(); }
+
+    inline std::string get_stranger_info_base64(const int64_t user_id, const bool no_cache = false) noexcept(false) {
+        return try_get_stranger_info_base64(user_id, no_cache).value();
+    }
+
+    inline std::string get_friend_list_base64() noexcept(false) { return try_get_friend_list_base64().value(); }
+
+    inline std::string get_group_list_base64() noexcept(false) { return try_get_group_list_base64().value(); }
+
     inline std::string get_group_info_base64(const int64_t group_id, const bool no_cache = false) noexcept(false) {
-        const auto ret = raw::CQ_getGroupInfo(app::auth_code, group_id, no_cache);
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+        return try_get_group_info_base64(group_id, no_cache).value();
     }
 
     inline std::string get_group_member_list_base64(const int64_t group_id) noexcept(false) {
-        const auto ret = raw::CQ_getGroupMemberList(app::auth_code, group_id);
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+        return try_get_group_member_list_base64(group_id).value();
     }
 
     inline std::string get_group_member_info_base64(const int64_t group_id, const int64_t user_id,
                                                     const bool no_cache = false) noexcept(false) {
-        const auto ret = raw::CQ_getGroupMemberInfoV2(app::auth_code, group_id, user_id, no_cache);
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+        return try_get_group_member_info_base64(group_id, user_id, no_cache).value();
     }
 
 #pragma endregion
 
 #pragma region Get CoolQ Information
 
-    inline std::string get_cookies() noexcept(false) {
-        const auto ret = raw::CQ_getCookies(app::auth_code);
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+    inline Result<std::string> try_get_cookies() {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getCookies(app::auth_code));
     }
 
-    inline std::string get_cookies(const std::string &domain) noexcept(false) {
-        const auto ret = raw::CQ_getCookiesV2(app::auth_code, utils::string_to_coolq(domain).c_str());
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+    inline Result<std::string> try_get_cookies(const std::string &domain) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getCookiesV2(app::auth_code, utils::string_to_coolq_arg(domain)));
     }
 
-    inline int32_t get_csrf_token() noexcept { return raw::CQ_getCsrfToken(app::auth_code); }
+    inline int32_t get_csrf_token() noexcept {
+        CQ_TRACE_SPAN(API, __func__);
+        return raw::CQ_getCsrfToken(app::auth_code);
+    }
 
-    inline std::string get_app_directory() noexcept(false) {
-        const auto ret = raw::CQ_getAppDirectory(app::auth_code);
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+    inline Result<std::string> try_get_app_directory() {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getAppDirectory(app::auth_code));
     }
 
-    inline std::string get_record(const std::string &file, const std::string &out_format,
-                                  const bool full_path = false) noexcept(false) {
-        const auto ret =
+    inline Result<std::string> try_get_record(const std::string &file, const std::string &out_format,
+                                              const bool full_path = false) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(
             full_path
                 ? raw::CQ_getRecordV2(
-                      app::auth_code, utils::string_to_coolq(file).c_str(), utils::string_to_coolq(out_format).c_str())
+                      app::auth_code, utils::string_to_coolq_arg(file), utils::string_to_coolq_arg(out_format))
                 : raw::CQ_getRecord(
-                      app::auth_code, utils::string_to_coolq(file).c_str(), utils::string_to_coolq(out_format).c_str());
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+                      app::auth_code, utils::string_to_coolq_arg(file), utils::string_to_coolq_arg(out_format)));
     }
 
-    inline std::string get_image(const std::string &file) noexcept(false) {
-        const auto ret = raw::CQ_getImage(app::auth_code, utils::string_to_coolq(file).c_str());
-        __throw_if_needed(ret);
-        return utils::string_from_coolq(ret);
+    inline Result<std::string> try_get_image(const std::string &file) {
+        CQ_TRACE_SPAN(API, __func__);
+        return __string_result(raw::CQ_getImage(app::auth_code, utils::string_to_coolq_arg(file)));
     }
 
-    inline bool can_send_image() noexcept(false) { return static_cast<bool>(raw::CQ_canSendImage(app::auth_code)); }
+    inline std::string get_cookies() noexcept(false) { return try_get_cookies().value(); }
 
-    inline bool can_send_record() noexcept(false) { return static_cast<bool>(raw::CQ_canSendRecord(app::auth_code)); }
+    inline std::string get_cookies(const std::string &domain) noexcept(false) {
+        return try_get_cookies(domain).value();
+    }
+
+    inline std::string get_app_directory() noexcept(false) { return try_get_app_directory().value(); }
+
+    inline std::string get_record(const std::string &file, const std::string &out_format,
+                                  const bool full_path = false) noexcept(false) {
+        return try_get_record(file, out_format, full_path).value();
+    }
+
+    inline std::string get_image(const std::string &file) noexcept(false) { return try_get_image(file).value(); }
+
+    inline bool can_send_image() noexcept(false) {
+        CQ_TRACE_SPAN(API, __func__);
+        return static_cast<bool>(raw::CQ_canSendImage(app::auth_code));
+    }
+
+    inline bool can_send_record() noexcept(false) {
+        CQ_TRACE_SPAN(API, __func__);
+        return static_cast<bool>(raw::CQ_canSendRecord(app::auth_code));
+    }
 
 #pragma endregion
 
@@ -266,66 +511,61 @@ namespace cq::api {
 
 #pragma region CQSDK Bonus
 
+    /**
+     * Send a message to the given target, and remember it in message_cache if enabled.
+     */
+    Result<int64_t> try_send_msg(const Target &target, const std::string &msg);
+
     inline int64_t send_msg(const Target &target, const std::string &msg) noexcept(false) {
-        if (target.group_id.has_value()) {
-            return send_group_msg(target.group_id.value(), msg);
-        }
-        if (target.discuss_id.has_value()) {
-            return send_discuss_msg(target.discuss_id.value(), msg);
-        }
-        if (target.user_id.has_value()) {
-            return send_private_msg(target.user_id.value(), msg);
-        }
-        throw exception::ApiError(exception::ApiError::INVALID_TARGET);
+        return try_send_msg(target, msg).value();
     }
 
-    inline User get_stranger_info(const int64_t user_id, const bool no_cache = false) noexcept(false) {
-        try {
-            return ObjectHelper::from_base64<User>(get_stranger_info_base64(user_id, no_cache));
-        } catch (exception::ParseError &) {
-            throw exception::ApiError(exception::ApiError::INVALID_DATA);
-        }
+    inline Result<User> try_get_stranger_info(const int64_t user_id, const bool no_cache = false) {
+        return __object_result<User>(try_get_stranger_info_base64(user_id, no_cache));
     }
 
-    inline std::vector<Friend> get_friend_list() noexcept(false) {
-        try {
-            return ObjectHelper::multi_from_base64<std::vector<Friend>>(get_friend_list_base64());
-        } catch (exception::ParseError &) {
-            throw exception::ApiError(exception::ApiError::INVALID_DATA);
-        }
+    inline Result<std::vector<Friend>> try_get_friend_list() {
+        return __objects_result<std::vector<Friend>>(try_get_friend_list_base64());
     }
 
-    inline std::vector<Group> get_group_list() noexcept(false) {
-        try {
-            return ObjectHelper::multi_from_base64<std::vector<Group>>(get_group_list_base64());
-        } catch (exception::ParseError &) {
-            throw exception::ApiError(exception::ApiError::INVALID_DATA);
-        }
+    inline Result<std::vector<Group>> try_get_group_list() {
+        return __objects_result<std::vector<Group>>(try_get_group_list_base64());
     }
 
+    inline Result<Group> try_get_group_info(const int64_t group_id, const bool no_cache = false) {
+        return __object_result<Group>(try_get_group_info_base64(group_id, no_cache));
+    }
+
+    inline Result<std::vector<GroupMember>> try_get_group_member_list(const int64_t group_id) {
+        return __objects_result<std::vector<GroupMember>>(try_get_group_member_list_base64(group_id));
+    }
+
+    inline Result<GroupMember> try_get_group_member_info(const int64_t group_id, const int64_t user_id,
+                                                         const bool no_cache = false) {
+        return __object_result<GroupMember>(try_get_group_member_info_base64(group_id, user_id, no_cache));
+    }
+
+    inline Result<User> try_get_login_info() { return try_get_stranger_info(get_login_user_id()); }
+
+    inline User get_stranger_info(const int64_t user_id, const bool no_cache = false) noexcept(false) {
+        return try_get_stranger_info(user_id, no_cache).value();
+    }
+
+    inline std::vector<Friend> get_friend_list() noexcept(false) { return try_get_friend_list().value(); }
+
+    inline std::vector<Group> get_group_list() noexcept(false) { return try_get_group_list().value(); }
+
     inline Group get_group_info(const int64_t group_id, const bool no_cache = false) noexcept(false) {
-        try {
-            return ObjectHelper::from_base64<Group>(get_group_info_base64(group_id, no_cache));
-        } catch (exception::ParseError &) {
-            throw exception::ApiError(exception::ApiError::INVALID_DATA);
-        }
+        return try_get_group_info(group_id, no_cache).value();
     }
 
     inline std::vector<GroupMember> get_group_member_list(const int64_t group_id) noexcept(false) {
-        try {
-            return ObjectHelper::multi_from_base64<std::vector<GroupMember>>(get_group_member_list_base64(group_id));
-        } catch (exception::ParseError &) {
-            throw exception::ApiError(exception::ApiError::INVALID_DATA);
-        }
+        return try_get_group_member_list(group_id).value();
     }
 
     inline GroupMember get_group_member_info(const int64_t group_id, const int64_t user_id,
                                              const bool no_cache = false) noexcept(false) {
-        try {
-            return ObjectHelper::from_base64<GroupMember>(get_group_member_info_base64(group_id, user_id, no_cache));
-        } catch (exception::ParseError &) {
-            throw exception::ApiError(exception::ApiError::INVALID_DATA);
-        }
+        return try_get_group_member_info(group_id, user_id, no_cache).value();
     }
 
     inline User get_login_info() noexcept(false) { return get_stranger_info(get_login_user_id()); }
@@ -1,8 +1,16 @@
 #include "./app.h"
 
+#include <atomic>
+
 #include "./api.h"
+#include "./archive.h"
+#include "./conversation.h"
 #include "./def.h"
+#include "./dir.h"
+#include "./group_tracker.h"
+#include "./scheduler.h"
 #include "./utils/function.h"
+#include "./watchdog.h"
 
 namespace cq {
     Config config;
@@ -17,6 +25,20 @@ namespace cq {
         std::function<void()> on_coolq_exit;
 
         std::function<void()> __main;
+
+        static std::atomic<int64_t> login_user_id_cache{0};
+
+        int64_t login_user_id() {
+            auto user_id = login_user_id_cache.load(std::memory_order_relaxed);
+            if (user_id == 0) {
+                // 0 means not fetched, or not logged in yet, in which case we should try again next time
+                user_id = api::get_login_user_id();
+                login_user_id_cache.store(user_id, std::memory_order_relaxed);
+            }
+            return user_id;
+        }
+
+        void __reset_login_user_id() { login_user_id_cache.store(0, std::memory_order_relaxed); }
     } // namespace app
 } // namespace cq
 
@@ -48,6 +70,12 @@ __CQ_EVENT(int32_t, Initialize, 4)
  */
 __CQ_EVENT(int32_t, cq_app_enable, 0)
 () {
+    // the login user may have changed
+    app::__reset_login_user_id();
+    dir::__reset_cache();
+    group_tracker.reset();
+    scheduler::__start();
+    message_archive.__resume();
     call_if_valid(app::on_enable);
     return 0;
 }
@@ -58,6 +86,12 @@ __CQ_EVENT(int32_t, cq_app_enable, 0)
 __CQ_EVENT(int32_t, cq_app_disable, 0)
 () {
     call_if_valid(app::on_disable);
+    message_archive.__suspend();
+#ifdef CQ_HAS_COROUTINE
+    conversation::__stop();
+#endif
+    scheduler::__stop();
+    watchdog::__stop();
     return 0;
 }
 
@@ -76,5 +110,11 @@ __CQ_EVENT(int32_t, cq_coolq_start, 0)
 __CQ_EVENT(int32_t, cq_coolq_exit, 0)
 () {
     call_if_valid(app::on_coolq_exit);
+    message_archive.__suspend();
+#ifdef CQ_HAS_COROUTINE
+    conversation::__stop();
+#endif
+    scheduler::__stop();
+    watchdog::__stop();
     return 0;
 }
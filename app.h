@@ -5,6 +5,7 @@
 namespace cq {
     struct Config {
         bool convert_unicode_emoji = true;
+        bool coalesce_replies = false; // coalesce messages sent in each event handler, see message::SendCoalescer
     };
 
     extern Config config;
@@ -59,6 +60,18 @@ namespace cq {
         extern std::function<void()> on_coolq_exit;
 
         extern std::function<void()> __main;
+
+        /**
+         * Get the login user id.
+         * It's fetched once and cached until the app is enabled again, since it won't change in between.
+         */
+        int64_t login_user_id();
+
+        /**
+         * Forget the cached login user id.
+         * This is internally called when the app is enabled.
+         */
+        void __reset_login_user_id();
     } // namespace app
 } // namespace cq
 
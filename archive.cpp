@@ -0,0 +1,367 @@
+#include "./archive.h"
+
+#include <ctime>
+#include <filesystem>
+
+#include "./dir.h"
+#include "./logging.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace cq {
+    MessageArchive message_archive;
+
+    // record layout, big endian as what BinPack understands:
+    //     int32 size (of the rest of the record), int32 msg_id, int64 group_id, int64 user_id,
+    //     int32 time, int32 font, int32 length of raw_message, raw_message (UTF-8)
+    // a zero size marks the end of the data in a segment
+    static const size_t RECORD_FIXED_SIZE = 4 + 4 + 8 + 8 + 4 + 4 + 4;
+
+    template <typename IntType>
+    static char *put_int(char *out, const IntType value) {
+        for (auto i = static_cast<int>(sizeof(IntType)) - 1; i >= 0; i--) {
+            *out++ = static_cast<char>((static_cast<uint64_t>(value) >> (i * 8)) & 0xFF);
+        }
+        return out;
+    }
+
+    template <typename IntType>
+    static IntType get_int(const char *in) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(IntType); i++) {
+            value = value << 8 | static_cast<unsigned char>(in[i]);
+        }
+        return static_cast<IntType>(value);
+    }
+
+    static MessageArchive::Record parse_record(const char *data) {
+        const auto size = get_int<int32_t>(data);
+        const auto length = get_int<int32_t>(data + 32);
+        if (length < 0 || int64_t(length) + int64_t(RECORD_FIXED_SIZE) > int64_t(size) + 4) {
+            throw exception::ParseError("corrupted message archive record");
+        }
+        MessageArchive::Record record;
+        record.msg_id = get_int<int32_t>(data + 4);
+        record.group_id = get_int<int64_t>(data + 8);
+        record.user_id = get_int<int64_t>(data + 16);
+        record.time = get_int<int32_t>(data + 24);
+        record.font = get_int<int32_t>(data + 28);
+        record.raw_message.assign(data + RECORD_FIXED_SIZE, length);
+        return record;
+    }
+
+    // the ids of the segment files in the directory, in ascending order
+    static vector<uint32_t> list_segment_ids(const string &dir) {
+        static const string prefix = "segment_", suffix = ".log";
+        vector<uint32_t> ids;
+        error_code ec;
+        for (const auto &entry : fs::directory_iterator(utils::ansi(dir), ec)) {
+            const auto name = entry.path().filename().string();
+            if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0
+                || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+                continue;
+            }
+            const auto digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+            if (digits.find_first_not_of("0123456789") == string::npos && digits.size() <= 9) {
+                ids.push_back(static_cast<uint32_t>(stoul(digits)));
+            }
+        }
+        sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    void MessageArchive::open(const Options &options) {
+        if (running_) {
+            return;
+        }
+        options_ = options;
+        dir_ = dir::app(options_.sub_dir_name);
+        index_.clear();
+
+        // rebuild the index from existing segments
+        const auto ids = list_segment_ids(dir_);
+        for (const auto id : ids) {
+            utils::MappedFile file(segment_path(id));
+            index_segment(id, file.data(), file.size());
+        }
+        first_segment_id_ = ids.empty() ? 0 : ids.front();
+        open_segment(ids.empty() ? 0 : ids.back());
+        while (options_.max_segments > 0 && segment_id_ - first_segment_id_ >= options_.max_segments) {
+            drop_oldest_segment();
+        }
+
+        running_ = true;
+        writer_ = thread([this] { run_writer(); });
+    }
+
+    void MessageArchive::open() { open(Options()); }
+
+    void MessageArchive::close() {
+        suspended_ = false;
+        {
+            lock_guard<mutex> lock(queue_mutex_);
+            if (!running_) {
+                return;
+            }
+            running_ = false;
+        }
+        queue_cv_.notify_all();
+        writer_.join();
+
+        lock_guard<mutex> lock(segment_mutex_);
+        segment_.flush(0, segment_end_);
+        segment_.close();
+    }
+
+    void MessageArchive::__suspend() {
+        const auto was_open = running_.load();
+        close();
+        suspended_ = was_open;
+    }
+
+    void MessageArchive::__resume() {
+        if (!suspended_) {
+            return;
+        }
+        suspended_ = false;
+        try {
+            open(options_);
+        } catch (std::exception &e) {
+            logging::error("MessageArchive", string("failed to open the archive again: ") + e.what());
+        }
+    }
+
+    void MessageArchive::append(const event::MessageEvent &e) {
+        if (!running_ || !e.target.group_id.has_value() || !e.target.user_id.has_value()) {
+            return;
+        }
+
+        Record record;
+        record.msg_id = e.message_id;
+        record.group_id = e.target.group_id.value();
+        record.user_id = e.target.user_id.value();
+        record.time = static_cast<int32_t>(std::time(nullptr));
+        record.font = e.font;
+        record.raw_message = e.raw_message;
+
+        lock_guard<mutex> lock(queue_mutex_);
+        queue_.push_back(std::move(record));
+        queued_count_++;
+    }
+
+    void MessageArchive::flush() {
+        unique_lock<mutex> lock(queue_mutex_);
+        const auto target = queued_count_;
+        flush_requested_ = true;
+        queue_cv_.notify_all();
+        written_cv_.wait(lock, [&] { return written_count_ >= target || !running_; });
+    }
+
+    vector<MessageArchive::Record> MessageArchive::last_messages(const int64_t group_id, const size_t n) const {
+        vector<Location> locations;
+        {
+            shared_lock<shared_mutex> lock(index_mutex_);
+            if (const auto it = index_.find(group_id); it != index_.end()) {
+                const auto &all = it->second.locations;
+                locations.assign(all.end() - min(n, all.size()), all.end());
+            }
+        }
+        return read(locations);
+    }
+
+    vector<MessageArchive::Record> MessageArchive::last_messages(const int64_t group_id, const int64_t user_id,
+                                                                 const size_t n) const {
+        vector<Location> locations;
+        {
+            shared_lock<shared_mutex> lock(index_mutex_);
+            if (const auto it = index_.find(group_id); it != index_.end()) {
+                if (const auto user_it = it->second.by_user.find(user_id); user_it != it->second.by_user.end()) {
+                    const auto &positions = user_it->second;
+                    for (auto pos = positions.end() - min(n, positions.size()); pos != positions.end(); ++pos) {
+                        locations.push_back(it->second.locations[*pos - it->second.base]);
+                    }
+                }
+            }
+        }
+        return read(locations);
+    }
+
+    vector<MessageArchive::Record> MessageArchive::messages_between(const int64_t group_id, const int32_t from_time,
+                                                                    const int32_t to_time) const {
+        vector<Location> locations;
+        {
+            shared_lock<shared_mutex> lock(index_mutex_);
+            if (const auto it = index_.find(group_id); it != index_.end()) {
+                const auto &all = it->second.locations;
+                const auto by_time = [](const Location &loc, const int32_t time) { return loc.time < time; };
+                locations.assign(lower_bound(all.begin(), all.end(), from_time, by_time),
+                                 lower_bound(all.begin(), all.end(), to_time, by_time));
+            }
+        }
+        return read(locations);
+    }
+
+    string MessageArchive::segment_path(const uint32_t id) const {
+        auto name = to_string(id);
+        name.insert(0, name.size() < 6 ? 6 - name.size() : 0, '0');
+        return dir_ + "segment_" + name + ".log";
+    }
+
+    void MessageArchive::open_segment(const uint32_t id) {
+        segment_ = utils::MappedFile(segment_path(id), utils::MappedFile::READ_WRITE, options_.segment_size);
+        segment_id_ = id;
+        segment_end_ = 0;
+        while (segment_end_ + 4 <= segment_.size()) {
+            const auto size = get_int<int32_t>(segment_.data() + segment_end_);
+            if (size <= 0) {
+                break;
+            }
+            segment_end_ += 4 + size;
+        }
+    }
+
+    void MessageArchive::index_segment(const uint32_t id, const char *data, const size_t size) {
+        size_t offset = 0;
+        unique_lock<shared_mutex> lock(index_mutex_);
+        while (offset + RECORD_FIXED_SIZE <= size) {
+            const auto record_size = get_int<int32_t>(data + offset);
+            if (record_size <= 0 || offset + 4 + record_size > size) {
+                break;
+            }
+            const auto group_id = get_int<int64_t>(data + offset + 8);
+            const auto user_id = get_int<int64_t>(data + offset + 16);
+            const auto time = get_int<int32_t>(data + offset + 24);
+
+            auto &group = index_[group_id];
+            group.by_user[user_id].push_back(group.base + group.locations.size());
+            group.locations.push_back({time, id, static_cast<uint32_t>(offset)});
+            offset += 4 + record_size;
+        }
+    }
+
+    void MessageArchive::drop_oldest_segment() {
+        const auto id = first_segment_id_++;
+        {
+            // the segments are written in order, so the locations in a dropped segment come first in every group
+            unique_lock<shared_mutex> lock(index_mutex_);
+            for (auto it = index_.begin(); it != index_.end();) {
+                auto &group = it->second;
+                size_t dropped = 0;
+                while (dropped < group.locations.size() && group.locations[dropped].segment <= id) {
+                    dropped++;
+                }
+                if (dropped == group.locations.size()) {
+                    it = index_.erase(it);
+                    continue;
+                }
+                if (dropped > 0) {
+                    group.locations.erase(group.locations.begin(), group.locations.begin() + dropped);
+                    group.base += dropped;
+                    for (auto user_it = group.by_user.begin(); user_it != group.by_user.end();) {
+                        auto &positions = user_it->second;
+                        positions.erase(positions.begin(), lower_bound(positions.begin(), positions.end(), group.base));
+                        user_it = positions.empty() ? group.by_user.erase(user_it) : next(user_it);
+                    }
+                }
+                ++it;
+            }
+        }
+        error_code ec;
+        fs::remove(utils::ansi(segment_path(id)), ec);
+    }
+
+    void MessageArchive::write_batch(vector<Record> &batch) {
+        lock_guard<mutex> lock(segment_mutex_);
+        auto begin = segment_end_;
+        for (const auto &record : batch) {
+            const auto size = RECORD_FIXED_SIZE + record.raw_message.size();
+            if (size + 4 > options_.segment_size) {
+                logging::warning("MessageArchive",
+                                 "message " + to_string(record.msg_id) + " of group " + to_string(record.group_id)
+                                     + " is larger than a segment, and is not archived");
+                continue;
+            }
+            if (segment_end_ + size + 4 > segment_.size()) {
+                // leave the rest of this segment zeroed, and continue in the next one
+                segment_.flush(begin, segment_end_ - begin);
+                open_segment(segment_id_ + 1);
+                begin = 0;
+                while (options_.max_segments > 0 && segment_id_ - first_segment_id_ >= options_.max_segments) {
+                    drop_oldest_segment();
+                }
+            }
+
+            const auto offset = segment_end_;
+            auto out = segment_.data() + offset;
+            out = put_int(out, static_cast<int32_t>(size - 4));
+            out = put_int(out, record.msg_id);
+            out = put_int(out, record.group_id);
+            out = put_int(out, record.user_id);
+            out = put_int(out, record.time);
+            out = put_int(out, record.font);
+            out = put_int(out, static_cast<int32_t>(record.raw_message.size()));
+            memcpy(out, record.raw_message.data(), record.raw_message.size());
+            segment_end_ += size;
+
+            unique_lock<shared_mutex> index_lock(index_mutex_);
+            auto &group = index_[record.group_id];
+            group.by_user[record.user_id].push_back(group.base + group.locations.size());
+            group.locations.push_back({record.time, segment_id_, static_cast<uint32_t>(offset)});
+        }
+        segment_.flush(begin, segment_end_ - begin);
+    }
+
+    void MessageArchive::run_writer() {
+        vector<Record> batch;
+        unique_lock<mutex> lock(queue_mutex_);
+        while (true) {
+            queue_cv_.wait_for(lock, options_.flush_interval, [this] { return !running_ || flush_requested_; });
+            flush_requested_ = false;
+            batch.swap(queue_);
+            const auto stopping = !running_;
+            lock.unlock();
+
+            const auto count = batch.size();
+            write_batch(batch);
+            batch.clear();
+
+            lock.lock();
+            written_count_ += count;
+            written_cv_.notify_all();
+            if (stopping && queue_.empty()) {
+                break;
+            }
+        }
+    }
+
+    vector<MessageArchive::Record> MessageArchive::read(const vector<Location> &locations) const {
+        vector<Record> result;
+        result.reserve(locations.size());
+
+        uint32_t mapped_id = UINT32_MAX;
+        utils::MappedFile mapped;
+        for (const auto &loc : locations) {
+            {
+                lock_guard<mutex> lock(segment_mutex_);
+                if (loc.segment == segment_id_ && segment_.is_open()) {
+                    result.push_back(parse_record(segment_.data() + loc.offset));
+                    continue;
+                }
+            }
+            if (loc.segment != mapped_id) {
+                // an older segment, map it only for this lookup
+                try {
+                    mapped = utils::MappedFile(segment_path(loc.segment));
+                } catch (exception::RuntimeError &) {
+                    mapped.close(); // dropped in the meantime
+                }
+                mapped_id = loc.segment;
+            }
+            if (mapped.is_open()) {
+                result.push_back(parse_record(mapped.data() + loc.offset));
+            }
+        }
+        return result;
+    }
+} // namespace cq
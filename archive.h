@@ -0,0 +1,134 @@
+#pragma once
+
+#include "./common.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "./event.h"
+#include "./utils/mmap.h"
+
+namespace cq {
+    /**
+     * An append-only archive of group messages, stored in memory-mapped segment files under dir::app.
+     *
+     * Messages are queued by the event thread and written in batches by a background thread.
+     * An in-memory index by group (in time order) and by (group, user) is rebuilt from the
+     * segments on open(), so lookups never scan the files. Only the newest max_segments segments
+     * are kept, which bounds both the disk usage and the index.
+     *
+     * An archive opened by the app is closed when the app is disabled, and opened again with the
+     * same options when it's enabled.
+     */
+    class MessageArchive {
+    public:
+        struct Options {
+            std::string sub_dir_name = "archive";
+            size_t segment_size = 16 * 1024 * 1024; // also the max size of a single record
+            size_t max_segments = 64; // the oldest segment is deleted when a new one would exceed this
+            std::chrono::milliseconds flush_interval{200};
+        };
+
+        struct Record {
+            int32_t msg_id = 0;
+            int64_t group_id = 0;
+            int64_t user_id = 0;
+            int32_t time = 0;
+            int32_t font = 0;
+            std::string raw_message;
+        };
+
+        ~MessageArchive() { close(); }
+
+        /**
+         * Open the archive, rebuild the index from existing segments, and start the writer thread.
+         */
+        void open(const Options &options) noexcept(false);
+        void open() noexcept(false);
+
+        /**
+         * Write all pending messages, and stop the writer thread.
+         */
+        void close();
+
+        bool is_open() const noexcept { return running_; }
+
+        /**
+         * Queue a message for writing. Messages not from a group are ignored.
+         */
+        void append(const event::MessageEvent &e);
+
+        /**
+         * Block until all messages queued so far are written.
+         */
+        void flush();
+
+        /**
+         * Get the last n messages of a group, or of a user in a group, the oldest first.
+         */
+        std::vector<Record> last_messages(int64_t group_id, size_t n) const;
+        std::vector<Record> last_messages(int64_t group_id, int64_t user_id, size_t n) const;
+
+        /**
+         * Get the messages of a group with from_time <= time < to_time.
+         */
+        std::vector<Record> messages_between(int64_t group_id, int32_t from_time, int32_t to_time) const;
+
+        /**
+         * Close the archive, and remember to open it again on __resume() if it was open.
+         * These are internally called when the app is disabled and enabled, or CoolQ is exiting.
+         */
+        void __suspend();
+        void __resume();
+
+    private:
+        struct Location {
+            int32_t time;
+            uint32_t segment;
+            uint32_t offset;
+        };
+
+        struct GroupIndex {
+            std::vector<Location> locations; // in time order
+            // positions in "locations", plus "base", which is the number of locations dropped from the front
+            std::unordered_map<int64_t, std::vector<uint64_t>> by_user;
+            uint64_t base = 0;
+        };
+
+        Options options_;
+        std::string dir_;
+
+        std::vector<Record> queue_;
+        size_t queued_count_ = 0, written_count_ = 0;
+        std::mutex queue_mutex_;
+        std::condition_variable queue_cv_, written_cv_;
+        std::thread writer_;
+        std::atomic<bool> running_{false};
+        bool flush_requested_ = false;
+        bool suspended_ = false;
+
+        mutable std::mutex segment_mutex_; // guards the current segment
+        utils::MappedFile segment_;
+        uint32_t first_segment_id_ = 0;
+        uint32_t segment_id_ = 0;
+        size_t segment_end_ = 0;
+
+        mutable std::shared_mutex index_mutex_;
+        std::unordered_map<int64_t, GroupIndex> index_;
+
+        std::string segment_path(uint32_t id) const;
+        void open_segment(uint32_t id);
+        void index_segment(uint32_t id, const char *data, size_t size);
+        void drop_oldest_segment();
+        void write_batch(std::vector<Record> &batch);
+        void run_writer();
+        std::vector<Record> read(const std::vector<Location> &locations) const;
+    };
+
+    extern MessageArchive message_archive;
+} // namespace cq
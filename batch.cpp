@@ -0,0 +1,137 @@
+#include "./batch.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace cq::api {
+    static void execute_one(const ModerationOp &op) noexcept(false) {
+        switch (op.kind) {
+        case ModerationOp::BAN:
+            set_group_ban(op.group_id, op.user_id, op.duration);
+            break;
+        case ModerationOp::KICK:
+            set_group_kick(op.group_id, op.user_id, op.reject_add_request);
+            break;
+        case ModerationOp::SET_CARD:
+            set_group_card(op.group_id, op.user_id, op.text);
+            break;
+        case ModerationOp::SET_SPECIAL_TITLE:
+            set_group_special_title(op.group_id, op.user_id, op.text, op.duration);
+            break;
+        case ModerationOp::DELETE_MSG:
+            delete_msg(op.msg_id);
+            break;
+        }
+    }
+
+    vector<BatchResult> execute_batch(const vector<ModerationOp> &ops, const BatchOptions &options) {
+        vector<BatchResult> results(ops.size());
+
+        // the index of the operation whose result each operation shares (itself, if not coalesced)
+        vector<size_t> owner(ops.size());
+        vector<size_t> todo;
+        todo.reserve(ops.size());
+
+        if (options.coalesce) {
+            // (kind, group_id, user_id or msg_id) -> index of the last operation with that key
+            map<tuple<int, int64_t, int64_t>, size_t> last;
+            for (size_t i = 0; i < ops.size(); i++) {
+                const auto &op = ops[i];
+                const auto subject = op.kind == ModerationOp::DELETE_MSG ? op.msg_id : op.user_id;
+                last[{op.kind, op.group_id, subject}] = i;
+            }
+            for (size_t i = 0; i < ops.size(); i++) {
+                const auto &op = ops[i];
+                const auto subject = op.kind == ModerationOp::DELETE_MSG ? op.msg_id : op.user_id;
+                owner[i] = last[{op.kind, op.group_id, subject}];
+                if (owner[i] == i) {
+                    todo.push_back(i);
+                }
+            }
+        } else {
+            for (size_t i = 0; i < ops.size(); i++) {
+                owner[i] = i;
+                todo.push_back(i);
+            }
+        }
+
+        // operations on the same subject run on the same worker, one after another in submission order,
+        // e.g. a ban followed by a kick of the same member
+        vector<vector<size_t>> chains;
+        map<tuple<bool, int64_t, int64_t>, size_t> chain_of;
+        for (const auto i : todo) {
+            const auto &op = ops[i];
+            const auto is_msg = op.kind == ModerationOp::DELETE_MSG;
+            const auto [it, inserted] =
+                chain_of.emplace(make_tuple(is_msg, op.group_id, is_msg ? op.msg_id : op.user_id), chains.size());
+            if (inserted) {
+                chains.emplace_back();
+            }
+            chains[it->second].push_back(i);
+        }
+
+        atomic<size_t> next_chain{0};
+        mutex pace_mutex;
+        auto next_call_time = Clock::now();
+
+        const auto worker = [&] {
+            for (size_t c; (c = next_chain.fetch_add(1)) < chains.size();) {
+                for (const auto i : chains[c]) {
+                    if (options.interval.count() > 0) {
+                        Clock::time_point call_time;
+                        {
+                            lock_guard<mutex> lock(pace_mutex);
+                            call_time = max(next_call_time, Clock::now());
+                            next_call_time = call_time + options.interval;
+                        }
+                        this_thread::sleep_until(call_time);
+                    }
+
+                    // nothing may escape a worker thread, or std::terminate would take CoolQ down
+                    try {
+                        execute_one(ops[i]);
+                    } catch (exception::ApiError &e) {
+                        results[i].code = e.code;
+                    } catch (...) {
+                        results[i].code = BatchResult::OTHER_ERROR;
+                    }
+                }
+            }
+        };
+
+        // joins the started workers on every path, so that a failure to start one doesn't terminate
+        struct Workers {
+            vector<thread> threads;
+
+            ~Workers() {
+                for (auto &t : threads) {
+                    if (t.joinable()) {
+                        t.join();
+                    }
+                }
+            }
+        };
+
+        const auto worker_count = min(max(options.parallelism, size_t(1)), chains.size());
+        {
+            Workers workers;
+            for (size_t i = 1; i < worker_count; i++) {
+                workers.threads.emplace_back(worker);
+            }
+            worker(); // the calling thread works as well
+        }
+
+        for (size_t i = 0; i < ops.size(); i++) {
+            if (owner[i] != i) {
+                results[i].code = results[owner[i]].code;
+                results[i].coalesced = true;
+            }
+        }
+        return results;
+    }
+} // namespace cq::api
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "./common.h"
+
+#include <chrono>
+#include <future>
+
+#include "./api.h"
+
+namespace cq::api {
+    /**
+     * A single moderation operation, to be executed by execute_batch().
+     */
+    struct ModerationOp {
+        enum Kind { BAN, KICK, SET_CARD, SET_SPECIAL_TITLE, DELETE_MSG };
+
+        Kind kind = BAN;
+        int64_t group_id = 0;
+        int64_t user_id = 0;
+        int64_t msg_id = 0; // only for DELETE_MSG
+        int64_t duration = 0; // for BAN and SET_SPECIAL_TITLE
+        bool reject_add_request = false; // only for KICK
+        std::string text; // card for SET_CARD, special title for SET_SPECIAL_TITLE
+
+        static ModerationOp ban(const int64_t group_id, const int64_t user_id, const int64_t duration) {
+            ModerationOp op;
+            op.kind = BAN;
+            op.group_id = group_id;
+            op.user_id = user_id;
+            op.duration = duration;
+            return op;
+        }
+
+        static ModerationOp kick(const int64_t group_id, const int64_t user_id,
+                                 const bool reject_add_request = false) {
+            ModerationOp op;
+            op.kind = KICK;
+            op.group_id = group_id;
+            op.user_id = user_id;
+            op.reject_add_request = reject_add_request;
+            return op;
+        }
+
+        static ModerationOp card(const int64_t group_id, const int64_t user_id, const std::string &card) {
+            ModerationOp op;
+            op.kind = SET_CARD;
+            op.group_id = group_id;
+            op.user_id = user_id;
+            op.text = card;
+            return op;
+        }
+
+        static ModerationOp special_title(const int64_t group_id, const int64_t user_id,
+                                          const std::string &special_title, const int64_t duration = -1) {
+            ModerationOp op;
+            op.kind = SET_SPECIAL_TITLE;
+            op.group_id = group_id;
+            op.user_id = user_id;
+            op.text = special_title;
+            op.duration = duration;
+            return op;
+        }
+
+        static ModerationOp delete_msg(const int64_t msg_id) {
+            ModerationOp op;
+            op.kind = DELETE_MSG;
+            op.msg_id = msg_id;
+            return op;
+        }
+    };
+
+    struct BatchOptions {
+        size_t parallelism = 4; // max number of worker threads
+        std::chrono::milliseconds interval{0}; // min interval between two API calls, shared by all workers
+        bool coalesce = true; // merge operations of the same kind on the same (group, user), the last one wins
+    };
+
+    struct BatchResult {
+        int32_t code = 0; // 0 on success, otherwise the code of the ApiError thrown, or OTHER_ERROR
+        bool coalesced = false; // this operation was superseded by a later one, "code" is the result of that one
+
+        bool ok() const { return code == 0; }
+
+        static const int32_t OTHER_ERROR = 1; // an exception other than ApiError was thrown
+    };
+
+    /**
+     * Execute moderation operations on a bounded set of worker threads.
+     * Operations on the same (group, user) or message are executed one after another, in the order given.
+     * The returned vector has exactly one result for each operation, in the same order.
+     *
+     * The calling thread works too, and up to "parallelism - 1" threads are started for the call and joined
+     * before it returns, so it blocks until every operation is done. Call execute_batch_async() from event
+     * handlers instead, to keep CoolQ's event thread free.
+     */
+    std::vector<BatchResult> execute_batch(const std::vector<ModerationOp> &ops, const BatchOptions &options = {});
+
+    /**
+     * Same as execute_batch(), but return immediately, so that it won't block the event thread.
+     */
+    inline std::future<std::vector<BatchResult>> execute_batch_async(std::vector<ModerationOp> ops,
+                                                                     const BatchOptions &options = {}) {
+        return std::async(std::launch::async, [ops = std::move(ops), options] { return execute_batch(ops, options); });
+    }
+} // namespace cq::api
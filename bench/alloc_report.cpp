@@ -0,0 +1,52 @@
+#include "./fixtures.h"
+
+#include <iostream>
+
+#include "../event.h"
+#include "../utils/alloc_tracker.h"
+#include "../utils/string.h"
+
+using namespace std;
+using namespace cq;
+
+// exported by event.cpp, as called by CoolQ
+extern "C" int32_t cq_event_private_msg(int32_t sub_type, int32_t msg_id, int64_t from_qq, const char *msg,
+                                        int32_t font);
+extern "C" int32_t cq_event_group_msg(int32_t sub_type, int32_t msg_id, int64_t from_group, int64_t from_qq,
+                                      const char *from_anonymous, const char *msg, int32_t font);
+
+/**
+ * Replay the message corpus through the exported event functions, with allocation tracking
+ * compiled in, and print the allocations per category and per event.
+ *
+ *     alloc_report [passes]
+ */
+int main(const int argc, const char *argv[]) {
+    const auto passes = argc > 1 ? stoi(argv[1]) : 10;
+
+    bench::install_fake_api();
+    vector<string> encoded;
+    for (const auto &line : bench::read_corpus_lines("messages.txt")) {
+        encoded.push_back(utils::string_to_coolq(line));
+    }
+
+    size_t handled = 0;
+    event::on_private_msg = [&](const event::PrivateMessageEvent &e) { handled += e.message.size(); };
+    event::on_group_msg = [&](const event::GroupMessageEvent &e) { handled += e.message.size(); };
+
+    // everything above is setup, only count the replay
+    utils::alloc::reset();
+    int32_t msg_id = 0;
+    for (auto i = 0; i < passes; i++) {
+        for (const auto &msg : encoded) {
+            cq_event_private_msg(11, ++msg_id, 10001, msg.c_str(), 0);
+            cq_event_group_msg(1, ++msg_id, 123456789, 10001, "", msg.c_str(), 0);
+        }
+    }
+    const auto report = utils::alloc::report();
+
+    event::on_private_msg = nullptr;
+    event::on_group_msg = nullptr;
+    cout << report << endl << "message segments handled: " << handled << endl;
+    return handled > 0 ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#include "./fixtures.h"
+
+#include "../event.h"
+#include "../utils/string.h"
+
+using namespace std;
+using namespace cq;
+
+// exported by event.cpp, as called by CoolQ
+extern "C" int32_t cq_event_group_msg(int32_t sub_type, int32_t msg_id, int64_t from_group, int64_t from_qq,
+                                      const char *from_anonymous, const char *msg, int32_t font);
+
+/**
+ * The whole path of a group message, from the exported function to the user handler:
+ * GB18030 decoding, mentions, message parsing and dispatch.
+ */
+static void BM_GroupMessageDispatch(benchmark::State &state) {
+    bench::install_fake_api();
+    vector<string> encoded;
+    for (const auto &line : bench::read_corpus_lines("messages.txt")) {
+        encoded.push_back(utils::string_to_coolq(line));
+    }
+
+    size_t handled = 0;
+    event::on_group_msg = [&](const event::GroupMessageEvent &e) {
+        handled += e.message.size();
+    };
+    int32_t msg_id = 0;
+    for (auto _ : state) {
+        for (const auto &msg : encoded) {
+            cq_event_group_msg(1, ++msg_id, 123456789, 10001, "", msg.c_str(), 0);
+        }
+    }
+    event::on_group_msg = nullptr;
+    benchmark::DoNotOptimize(handled);
+    state.SetItemsProcessed(state.iterations() * encoded.size());
+}
+BENCHMARK(BM_GroupMessageDispatch);
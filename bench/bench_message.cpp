@@ -0,0 +1,154 @@
+#include "./fixtures.h"
+
+#include "../message.h"
+
+using namespace std;
+using namespace cq;
+using namespace cq::message;
+
+static const vector<string> &raw_messages() {
+    static const auto lines = bench::read_corpus_lines("messages.txt");
+    return lines;
+}
+
+static int64_t total_size(const vector<string> &strings) {
+    int64_t size = 0;
+    for (const auto &s : strings) {
+        size += s.size();
+    }
+    return size;
+}
+
+static void BM_MessageParse(benchmark::State &state) {
+    const auto &lines = raw_messages();
+    for (auto _ : state) {
+        for (const auto &line : lines) {
+            Message msg(line);
+            benchmark::DoNotOptimize(msg);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * lines.size());
+    state.SetBytesProcessed(state.iterations() * total_size(lines));
+}
+BENCHMARK(BM_MessageParse);
+
+static void BM_MessageSerialize(benchmark::State &state) {
+    vector<Message> messages(raw_messages().begin(), raw_messages().end());
+    for (auto _ : state) {
+        for (const auto &msg : messages) {
+            auto str = string(msg);
+            benchmark::DoNotOptimize(str);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * messages.size());
+}
+BENCHMARK(BM_MessageSerialize);
+
+static void BM_MessageExtractPlainText(benchmark::State &state) {
+    vector<Message> messages(raw_messages().begin(), raw_messages().end());
+    for (auto _ : state) {
+        for (const auto &msg : messages) {
+            auto text = msg.extract_plain_text();
+            benchmark::DoNotOptimize(text);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * messages.size());
+}
+BENCHMARK(BM_MessageExtractPlainText);
+
+// the unescaped text of the corpus, which is what escape() gets in practice
+static vector<string> plain_texts() {
+    vector<string> texts;
+    for (const auto &line : raw_messages()) {
+        texts.push_back(unescape(line));
+    }
+    return texts;
+}
+
+static void BM_Escape(benchmark::State &state) {
+    const auto escape_comma = state.range(0) != 0;
+    const auto texts = plain_texts();
+    for (auto _ : state) {
+        for (const auto &text : texts) {
+            auto escaped = escape(text, escape_comma);
+            benchmark::DoNotOptimize(escaped);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * total_size(texts));
+}
+BENCHMARK(BM_Escape)->ArgName("escape_comma")->Arg(0)->Arg(1);
+
+static void BM_EscapeNothingToEscape(benchmark::State &state) {
+    const string text(state.range(0), 'x');
+    for (auto _ : state) {
+        auto escaped = escape(text);
+        benchmark::DoNotOptimize(escaped);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_EscapeNothingToEscape)->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_Unescape(benchmark::State &state) {
+    const auto &lines = raw_messages();
+    for (auto _ : state) {
+        for (const auto &line : lines) {
+            auto unescaped = unescape(line);
+            benchmark::DoNotOptimize(unescaped);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * total_size(lines));
+}
+BENCHMARK(BM_Unescape);
+
+// a reply of mostly text, with an at or a face every few segments, like a generated ranking or report
+static MessageSegment reply_segment(const int64_t i) {
+    if (i % 10 == 3) {
+        return MessageSegment::at(10000 + i);
+    }
+    if (i % 10 == 7) {
+        return MessageSegment::face(static_cast<int>(i % 200));
+    }
+    return MessageSegment::text("第" + to_string(i) + "名 得分 " + to_string(i * 37 % 1000) + "\n");
+}
+
+/**
+ * How operator+= used to work: push the segment, then reduce() the whole message, which is quadratic.
+ */
+static void BM_BuildMessagePushAndReduce(benchmark::State &state) {
+    for (auto _ : state) {
+        Message msg;
+        for (int64_t i = 0; i < state.range(0); i++) {
+            msg.push_back(reply_segment(i));
+            msg.reduce();
+        }
+        benchmark::DoNotOptimize(msg);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BuildMessagePushAndReduce)->Arg(100)->Arg(1000);
+
+static void BM_BuildMessagePlusAssign(benchmark::State &state) {
+    for (auto _ : state) {
+        Message msg;
+        for (int64_t i = 0; i < state.range(0); i++) {
+            msg += reply_segment(i);
+        }
+        benchmark::DoNotOptimize(msg);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BuildMessagePlusAssign)->Arg(100)->Arg(1000);
+
+static void BM_BuildMessageBuilder(benchmark::State &state) {
+    for (auto _ : state) {
+        MessageBuilder builder;
+        builder.reserve(256);
+        for (int64_t i = 0; i < state.range(0); i++) {
+            builder << reply_segment(i);
+        }
+        auto msg = builder.build();
+        benchmark::DoNotOptimize(msg);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BuildMessageBuilder)->Arg(100)->Arg(1000);
@@ -0,0 +1,30 @@
+#include "./fixtures.h"
+
+#include "../rate_limit.h"
+
+using namespace std;
+using namespace cq;
+
+/**
+ * Cooldown checks of 100k users in 1000 groups, across threads.
+ * Most checks hit a bucket created earlier, like commands used over and over by active users.
+ */
+static void BM_RateLimiterCooldown(benchmark::State &state) {
+    static RateLimiter limiter;
+    if (state.thread_index() == 0) {
+        limiter.reset();
+    }
+
+    auto user = static_cast<uint64_t>(state.thread_index()) * 7919;
+    for (auto _ : state) {
+        user = (user * 6364136223846793005ULL + 1442695040888963407ULL);
+        const auto user_id = 10000 + static_cast<int64_t>(user >> 33) % state.range(0);
+        const auto target = Target(user_id, 100000 + user_id % 1000, Target::GROUP);
+        benchmark::DoNotOptimize(limiter.cooldown(target, "roll", chrono::seconds(5)));
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        state.counters["users"] = static_cast<double>(limiter.size());
+    }
+}
+BENCHMARK(BM_RateLimiterCooldown)->ArgName("users")->Arg(1000)->Arg(100000)->ThreadRange(1, 8)->UseRealTime();
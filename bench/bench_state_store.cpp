@@ -0,0 +1,103 @@
+#include "./fixtures.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#include "../state_store.h"
+
+using namespace std;
+using namespace cq;
+
+static const int64_t GROUP_COUNT = 10000;
+
+// 9 reads for each write, over 10k groups
+template <typename Get, typename Update>
+static void read_mostly(benchmark::State &state, Get get, Update update) {
+    auto x = static_cast<uint64_t>(state.thread_index()) * 7919 + 1;
+    for (auto _ : state) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        const auto target = Target::group(static_cast<int64_t>(x >> 33) % GROUP_COUNT);
+        if ((x >> 20) % 10 == 0) {
+            update(target);
+        } else {
+            benchmark::DoNotOptimize(get(target));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_StateStoreReadMostly(benchmark::State &state) {
+    static StateStore<int64_t> store;
+    if (state.thread_index() == 0) {
+        store.clear();
+        for (int64_t i = 0; i < GROUP_COUNT; i++) {
+            store.set(Target::group(i), i);
+        }
+    }
+    read_mostly(
+        state,
+        [](const Target &target) { return store.get_or(target, 0); },
+        [](const Target &target) { store.update(target, [](int64_t &v) { v++; }); });
+}
+BENCHMARK(BM_StateStoreReadMostly)->ThreadRange(1, 32)->UseRealTime();
+
+/**
+ * What StateStore replaces: a std::map behind a single mutex.
+ */
+static void BM_GlobalMutexMapReadMostly(benchmark::State &state) {
+    static mutex map_mutex;
+    static map<int64_t, int64_t> values;
+    if (state.thread_index() == 0) {
+        values.clear();
+        for (int64_t i = 0; i < GROUP_COUNT; i++) {
+            values[i] = i;
+        }
+    }
+    read_mostly(
+        state,
+        [](const Target &target) {
+            lock_guard<mutex> lock(map_mutex);
+            const auto it = values.find(*target.group_id);
+            return it != values.end() ? it->second : 0;
+        },
+        [](const Target &target) {
+            lock_guard<mutex> lock(map_mutex);
+            values[*target.group_id]++;
+        });
+}
+BENCHMARK(BM_GlobalMutexMapReadMostly)->ThreadRange(1, 32)->UseRealTime();
+
+/**
+ * The lock-free read alternative to StateStore: copy-on-write shards read with std::atomic_load,
+ * so a write copies its whole shard.
+ */
+static void BM_AtomicSnapshotShardsReadMostly(benchmark::State &state) {
+    using Shard = unordered_map<int64_t, int64_t>;
+    static const size_t SHARD_COUNT = 64;
+    static shared_ptr<const Shard> shards[SHARD_COUNT];
+    static mutex write_mutexes[SHARD_COUNT];
+    if (state.thread_index() == 0) {
+        vector<Shard> initial(SHARD_COUNT);
+        for (int64_t i = 0; i < GROUP_COUNT; i++) {
+            initial[i % SHARD_COUNT][i] = i;
+        }
+        for (size_t i = 0; i < SHARD_COUNT; i++) {
+            atomic_store(&shards[i], shared_ptr<const Shard>(make_shared<Shard>(std::move(initial[i]))));
+        }
+    }
+    read_mostly(
+        state,
+        [](const Target &target) {
+            const auto shard = atomic_load(&shards[*target.group_id % SHARD_COUNT]);
+            const auto it = shard->find(*target.group_id);
+            return it != shard->end() ? it->second : 0;
+        },
+        [](const Target &target) {
+            const auto index = *target.group_id % SHARD_COUNT;
+            lock_guard<mutex> lock(write_mutexes[index]);
+            auto copy = make_shared<Shard>(*atomic_load(&shards[index]));
+            (*copy)[*target.group_id]++;
+            atomic_store(&shards[index], shared_ptr<const Shard>(std::move(copy)));
+        });
+}
+BENCHMARK(BM_AtomicSnapshotShardsReadMostly)->ThreadRange(1, 32)->UseRealTime();
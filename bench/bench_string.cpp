@@ -0,0 +1,49 @@
+#include "./fixtures.h"
+
+#include "../utils/string.h"
+
+using namespace std;
+using namespace cq;
+
+static const string &utf8_text() {
+    static const auto text = bench::read_corpus_lines("messages.txt").at(1);
+    return text;
+}
+
+static void BM_StringToCoolq(benchmark::State &state) {
+    const auto &text = utf8_text();
+    for (auto _ : state) {
+        auto encoded = utils::string_to_coolq(text);
+        benchmark::DoNotOptimize(encoded);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_StringToCoolq);
+
+static void BM_StringToCoolqArg(benchmark::State &state) {
+    const auto &text = utf8_text();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::string_to_coolq_arg(text));
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_StringToCoolqArg);
+
+static void BM_StringToCoolqArgAscii(benchmark::State &state) {
+    const string text = "hello world, this is plain ASCII";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::string_to_coolq_arg(text));
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_StringToCoolqArgAscii);
+
+static void BM_StringFromCoolq(benchmark::State &state) {
+    const auto encoded = utils::string_to_coolq(utf8_text());
+    for (auto _ : state) {
+        auto decoded = utils::string_from_coolq(encoded);
+        benchmark::DoNotOptimize(decoded);
+    }
+    state.SetBytesProcessed(state.iterations() * encoded.size());
+}
+BENCHMARK(BM_StringFromCoolq);
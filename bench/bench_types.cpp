@@ -0,0 +1,86 @@
+#include "./fixtures.h"
+
+#include "../types.h"
+#include "../utils/base64.h"
+#include "../utils/binpack.h"
+
+using namespace std;
+using namespace cq;
+
+static void BM_Base64Decode(benchmark::State &state) {
+    const auto b64 = bench::read_corpus("group_member_list.b64");
+    for (auto _ : state) {
+        auto bytes = utils::base64::decode(b64);
+        benchmark::DoNotOptimize(bytes);
+    }
+    state.SetBytesProcessed(state.iterations() * b64.size());
+}
+BENCHMARK(BM_Base64Decode);
+
+static void BM_BinPackPopInt(benchmark::State &state) {
+    const string bytes(8 * 1024, '\x5a');
+    for (auto _ : state) {
+        utils::BinPack pack(bytes);
+        for (auto i = 0; i < 1024; i++) {
+            benchmark::DoNotOptimize(pack.pop_int<int64_t>());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+}
+BENCHMARK(BM_BinPackPopInt);
+
+static void BM_BinPackPopString(benchmark::State &state) {
+    // the first member in the list: group id, user id, then the nickname
+    const auto bytes = bench::read_corpus_bytes("group_member_info.b64");
+    for (auto _ : state) {
+        utils::BinPack pack(bytes);
+        pack.pop_int<int64_t>();
+        pack.pop_int<int64_t>();
+        auto nickname = pack.pop_string();
+        benchmark::DoNotOptimize(nickname);
+    }
+}
+BENCHMARK(BM_BinPackPopString);
+
+template <typename T>
+static void from_bytes(benchmark::State &state, const char *corpus) {
+    const auto bytes = bench::read_corpus_bytes(corpus);
+    for (auto _ : state) {
+        auto object = T::from_bytes(bytes);
+        benchmark::DoNotOptimize(object);
+    }
+}
+
+static void BM_UserFromBytes(benchmark::State &state) { from_bytes<User>(state, "stranger_info.b64"); }
+BENCHMARK(BM_UserFromBytes);
+
+static void BM_GroupFromBytes(benchmark::State &state) { from_bytes<Group>(state, "group_info.b64"); }
+BENCHMARK(BM_GroupFromBytes);
+
+static void BM_GroupMemberFromBytes(benchmark::State &state) {
+    from_bytes<GroupMember>(state, "group_member_info.b64");
+}
+BENCHMARK(BM_GroupMemberFromBytes);
+
+static void BM_AnonymousFromBytes(benchmark::State &state) { from_bytes<Anonymous>(state, "anonymous.b64"); }
+BENCHMARK(BM_AnonymousFromBytes);
+
+template <typename T>
+static void multi_from_base64(benchmark::State &state, const char *corpus) {
+    const auto b64 = bench::read_corpus(corpus);
+    size_t count = 0;
+    for (auto _ : state) {
+        auto objects = ObjectHelper::multi_from_base64<vector<T>>(b64);
+        count = objects.size();
+        benchmark::DoNotOptimize(objects);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+static void BM_GroupListFromBase64(benchmark::State &state) { multi_from_base64<Group>(state, "group_list.b64"); }
+BENCHMARK(BM_GroupListFromBase64);
+
+static void BM_GroupMemberListFromBase64(benchmark::State &state) {
+    multi_from_base64<GroupMember>(state, "group_member_list.b64");
+}
+BENCHMARK(BM_GroupMemberListFromBase64);
@@ -0,0 +1,123 @@
+// Check conversation::next_message with the scheduler stopped and running: resuming by a message,
+// by a timeout, by a newer wait for the same user, and by __stop(). conversation.cpp needs C++20.
+//
+//     check_conversation
+
+#include "./fixtures.h"
+
+#include <cstdio>
+#include <thread>
+
+#include "../conversation.h"
+#include "../scheduler.h"
+
+using namespace std;
+using namespace cq;
+
+static size_t failures = 0;
+
+static void check(const bool ok, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "failed: %s\n", what);
+        failures++;
+    }
+}
+
+struct Outcome {
+    bool resumed = false;
+    optional<string> reply;
+    thread::id resumed_on;
+};
+
+static conversation::Task wait_for(const Target target, const chrono::milliseconds timeout, Outcome &outcome) {
+    const auto reply = co_await conversation::next_message(target, timeout);
+    outcome.resumed = true;
+    outcome.resumed_on = this_thread::get_id();
+    if (reply) {
+        outcome.reply = reply->raw_message;
+    }
+}
+
+static conversation::Task throw_after_reply(const Target target) {
+    co_await conversation::next_message(target);
+    throw runtime_error("thrown after the reply");
+}
+
+static event::GroupMessageEvent message_from(const Target &target, const string &text) {
+    event::GroupMessageEvent e;
+    e.target = target;
+    e.raw_message = text;
+    return e;
+}
+
+static bool wait_until(const Outcome &outcome, const chrono::milliseconds limit) {
+    const auto deadline = chrono::steady_clock::now() + limit;
+    while (!outcome.resumed && chrono::steady_clock::now() < deadline) {
+        this_thread::sleep_for(chrono::milliseconds(5));
+    }
+    return outcome.resumed;
+}
+
+int main() {
+    bench::install_fake_api(); // for logging
+    const Target alice(10001, 123456, Target::GROUP), bob(10002, 123456, Target::GROUP);
+
+    {
+        Outcome outcome;
+        wait_for(alice, chrono::seconds(10), outcome);
+        check(outcome.resumed && !outcome.reply, "scheduler stopped: nullopt right away");
+        check(conversation::waiting_count() == 0, "scheduler stopped: nothing waiting");
+    }
+
+    scheduler::__start();
+
+    {
+        Outcome outcome;
+        wait_for(alice, chrono::seconds(10), outcome);
+        check(!outcome.resumed && conversation::waiting_count() == 1, "message: waiting");
+        check(!conversation::__dispatch(message_from(bob, "not me")), "message: other user not taken");
+        check(conversation::__dispatch(message_from(alice, "yes")), "message: taken");
+        check(outcome.resumed && outcome.reply == "yes", "message: resumed with the reply");
+        check(outcome.resumed_on == this_thread::get_id(), "message: resumed on the dispatching thread");
+    }
+
+    {
+        Outcome outcome;
+        wait_for(alice, chrono::milliseconds(30), outcome);
+        check(wait_until(outcome, chrono::seconds(5)) && !outcome.reply, "timeout: resumed with nullopt");
+        check(outcome.resumed_on != this_thread::get_id(), "timeout: resumed on a scheduler worker");
+        check(conversation::waiting_count() == 0, "timeout: nothing waiting");
+    }
+
+    {
+        Outcome first, second;
+        wait_for(alice, chrono::seconds(10), first);
+        wait_for(alice, chrono::seconds(10), second);
+        check(first.resumed && !first.reply, "superseded: first resumed with nullopt");
+        check(!second.resumed && conversation::waiting_count() == 1, "superseded: second waiting");
+        conversation::__dispatch(message_from(alice, "again"));
+        check(second.reply == "again", "superseded: second resumed with the reply");
+    }
+
+    {
+        throw_after_reply(alice);
+        check(conversation::__dispatch(message_from(alice, "boom")), "exception: taken");
+        check(conversation::waiting_count() == 0, "exception: conversation ended");
+    }
+
+    {
+        Outcome outcome;
+        wait_for(bob, chrono::seconds(10), outcome);
+        conversation::__stop();
+        check(outcome.resumed && !outcome.reply, "stop: resumed with nullopt");
+    }
+
+    scheduler::__stop();
+
+    if (failures > 0) {
+        fprintf(stderr, "%zu failure(s)\n", failures);
+        return 1;
+    }
+    printf("conversations resume as expected\n");
+    return 0;
+}
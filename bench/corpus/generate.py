@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""
+Generate the benchmark corpora in this directory.
+
+The output is deterministic, so the files only change when this script does.
+Binary data follows CoolQ's layout: big-endian integers, and strings as a 16-bit length plus GB18030 bytes.
+"""
+
+import base64
+import os
+import random
+import struct
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+rng = random.Random(20200101)
+
+NICKNAMES = ['小明', 'Alice', '夜猫子', 'bob_42', '[管理员]阿飞', 'ค่ะ', '안녕', 'Ünïcødé', '咸鱼&翻身', '']
+AREAS = ['北京', '上海', '广东', '', 'Overseas']
+LEVELS = ['活跃', '潜水', '冒泡', '吐槽']
+TITLES = ['', '', '群主大人', 'MVP']
+WORDS = ['你好', '今天', '吃了吗', 'hello', 'world', 'ok', '哈哈哈', '明天见', '收到', '+1', '???', '666', 'lol',
+         '这个', '怎么', '回事', 'a&b', '[doge]', 'x,y', 'https://example.com/a?b=1&c=2']
+
+
+def pack_int(fmt, value):
+    return struct.pack('>' + fmt, value)
+
+
+def pack_string(text):
+    data = text.encode('gb18030')
+    return pack_int('h', len(data)) + data
+
+
+def pack_token(data):
+    return pack_int('h', len(data)) + data
+
+
+def pack_multi(items):
+    return pack_int('i', len(items)) + b''.join(pack_token(item) for item in items)
+
+
+def group_member(group_id, user_id):
+    return b''.join([
+        pack_int('q', group_id),
+        pack_int('q', user_id),
+        pack_string(rng.choice(NICKNAMES)),
+        pack_string(rng.choice(NICKNAMES + ['', '', ''])),
+        pack_int('i', rng.choice([0, 1, 255])),
+        pack_int('i', rng.randint(0, 60)),
+        pack_string(rng.choice(AREAS)),
+        pack_int('i', 1500000000 + rng.randint(0, 80000000)),
+        pack_int('i', 1580000000 + rng.randint(0, 8000000)),
+        pack_string(rng.choice(LEVELS)),
+        pack_int('i', 3 if user_id == 10000 else rng.choice([1] * 20 + [2])),
+        pack_int('i', 0),
+        pack_string(rng.choice(TITLES)),
+        pack_int('i', -1),
+        pack_int('i', 1),
+    ])
+
+
+def group(group_id, with_counts):
+    data = pack_int('q', group_id) + pack_string('测试群 #%d' % group_id)
+    if with_counts:
+        data += pack_int('i', rng.randint(3, 2000)) + pack_int('i', 2000)
+    return data
+
+
+def stranger(user_id):
+    return pack_int('q', user_id) + pack_string(rng.choice(NICKNAMES)) + pack_int('i', 0) + pack_int('i', 23)
+
+
+def anonymous():
+    return pack_int('q', 1234567) + pack_string('大力水手') + pack_token(bytes(rng.randrange(256) for _ in range(40)))
+
+
+def text():
+    return ' '.join(rng.choice(WORDS) for _ in range(rng.randint(1, 12)))
+
+
+def escape(s, escape_comma):
+    s = s.replace('&', '&amp;').replace('[', '&#91;').replace(']', '&#93;')
+    return s.replace(',', '&#44;') if escape_comma else s
+
+
+def message():
+    parts = []
+    for _ in range(rng.randint(1, 6)):
+        kind = rng.random()
+        if kind < 0.55:
+            parts.append(escape(text(), False))
+        elif kind < 0.7:
+            parts.append('[CQ:at,qq=%d]' % rng.randint(10000, 99999999))
+        elif kind < 0.8:
+            parts.append('[CQ:face,id=%d]' % rng.randint(0, 200))
+        elif kind < 0.9:
+            parts.append('[CQ:image,file=%032X.jpg]' % rng.getrandbits(128))
+        elif kind < 0.95:
+            parts.append('[CQ:share,url=%s,title=%s,content=%s]' % (
+                escape(rng.choice(WORDS), True), escape(text(), True), escape(text(), True)))
+        else:
+            parts.append('[CQ:emoji,id=%d]' % rng.choice([128512, 128514, 10024]))
+    return ''.join(parts)
+
+
+def write(name, data):
+    with open(os.path.join(HERE, name), 'wb') as f:
+        f.write(data)
+
+
+def main():
+    group_id = 123456789
+    write('messages.txt', '\n'.join(message() for _ in range(500)).encode('utf-8') + b'\n')
+    write('group_member_list.b64', base64.b64encode(pack_multi(
+        [group_member(group_id, 10000 + i) for i in range(500)])))
+    write('group_member_info.b64', base64.b64encode(group_member(group_id, 10001)))
+    write('group_list.b64', base64.b64encode(pack_multi([group(group_id + i, False) for i in range(100)])))
+    write('group_info.b64', base64.b64encode(group(group_id, True)))
+    write('stranger_info.b64', base64.b64encode(stranger(10001)))
+    write('anonymous.b64', base64.b64encode(anonymous()))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,65 @@
+#include "./fixtures.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "../api.h"
+#include "../app.h"
+#include "../utils/base64.h"
+#include "../utils/string.h"
+
+using namespace std;
+
+namespace cq::bench {
+    string read_corpus(const string &name) {
+        ifstream file(CQ_BENCH_CORPUS_DIR + name, ios::binary);
+        if (!file) {
+            throw runtime_error("missing corpus file " + name);
+        }
+        stringstream ss;
+        ss << file.rdbuf();
+        return ss.str();
+    }
+
+    vector<string> read_corpus_lines(const string &name) {
+        vector<string> lines;
+        istringstream ss(read_corpus(name));
+        for (string line; getline(ss, line);) {
+            if (!line.empty()) {
+                lines.push_back(line);
+            }
+        }
+        return lines;
+    }
+
+    string read_corpus_bytes(const string &base64_name) { return utils::base64::decode(read_corpus(base64_name)); }
+
+    // the raw functions return pointers that CoolQ keeps valid until the next call, so do the fakes
+    static const char *keep(const string &str) {
+        static thread_local string result;
+        result = str;
+        return result.c_str();
+    }
+
+    void install_fake_api() {
+        namespace raw = api::raw;
+        static const auto member_list = read_corpus("group_member_list.b64");
+        static const auto member_info = read_corpus("group_member_info.b64");
+        static const auto group_list = read_corpus("group_list.b64");
+        static const auto group_info = read_corpus("group_info.b64");
+        static const auto stranger_info = read_corpus("stranger_info.b64");
+
+        raw::CQ_getLoginQQ = [](int32_t) -> int64_t { return LOGIN_USER_ID; };
+        raw::CQ_addLog = [](int32_t, int32_t, const char *, const char *) -> int32_t { return 0; };
+        raw::CQ_sendPrivateMsg = [](int32_t, int64_t, const char *) -> int32_t { return 1; };
+        raw::CQ_sendGroupMsg = [](int32_t, int64_t, const char *) -> int32_t { return 1; };
+        raw::CQ_sendDiscussMsg = [](int32_t, int64_t, const char *) -> int32_t { return 1; };
+        raw::CQ_getGroupMemberList = [](int32_t, int64_t) { return member_list.c_str(); };
+        raw::CQ_getGroupMemberInfoV2 = [](int32_t, int64_t, int64_t, int32_t) { return member_info.c_str(); };
+        raw::CQ_getGroupList = [](int32_t) { return group_list.c_str(); };
+        raw::CQ_getGroupInfo = [](int32_t, int64_t, int32_t) { return group_info.c_str(); };
+        raw::CQ_getStrangerInfo = [](int32_t, int64_t, int32_t) { return stranger_info.c_str(); };
+        raw::CQ_getImage = [](int32_t, const char *file) { return keep(string("/tmp/") + file); };
+        app::__reset_login_user_id();
+    }
+} // namespace cq::bench
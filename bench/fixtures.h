@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../common.h"
+
+#include <benchmark/benchmark.h>
+
+namespace cq::bench {
+    /**
+     * Read a file from the corpus directory, which is checked in next to the benchmarks.
+     */
+    std::string read_corpus(const std::string &name);
+
+    /**
+     * Read a corpus file as lines, without the line breaks.
+     */
+    std::vector<std::string> read_corpus_lines(const std::string &name);
+
+    std::string read_corpus_bytes(const std::string &base64_name);
+
+    /**
+     * Point the api::raw functions that the benchmarks reach at fakes answering from the corpus,
+     * instead of CoolQ. Safe to call more than once.
+     */
+    void install_fake_api();
+
+    static const int64_t LOGIN_USER_ID = 10000;
+} // namespace cq::bench
@@ -0,0 +1,93 @@
+// Check that message::escape and message::unescape behave exactly like the original
+// boost::replace_all implementations, on random strings made mostly of the characters that matter.
+//
+//     fuzz_escape [iterations] [seed]
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "../message.h"
+
+using namespace std;
+using namespace cq;
+
+static string reference_escape(string str, const bool escape_comma) {
+    boost::replace_all(str, "&", "&amp;");
+    boost::replace_all(str, "[", "&#91;");
+    boost::replace_all(str, "]", "&#93;");
+    if (escape_comma) boost::replace_all(str, ",", "&#44;");
+    return str;
+}
+
+static string reference_unescape(string str) {
+    boost::replace_all(str, "&#44;", ",");
+    boost::replace_all(str, "&#91;", "[");
+    boost::replace_all(str, "&#93;", "]");
+    boost::replace_all(str, "&amp;", "&");
+    return str;
+}
+
+/**
+ * A random string of single characters and whole or broken entities.
+ */
+static string random_string(mt19937_64 &rng) {
+    static const vector<string> pieces = {
+        "&", "[", "]", ",", "#", ";", "a", "m", "p", "4", "9", "1", "3", " ", "x", "\xe4\xbd\xa0", "\0",
+        "&amp;", "&#44;", "&#91;", "&#93;", "&amp", "&#4", "&#9", "&#;", "&&", "[CQ:", "&amp;amp;", "&#44;#44;",
+    };
+    const auto length = uniform_int_distribution<size_t>(0, 48)(rng);
+    string str;
+    for (size_t i = 0; i < length; i++) {
+        const auto &piece = pieces[uniform_int_distribution<size_t>(0, pieces.size() - 1)(rng)];
+        str += piece.empty() ? string(1, '\0') : piece;
+    }
+    // sometimes a long run without anything special, which takes the vectorized path
+    if (rng() % 4 == 0) {
+        str.insert(uniform_int_distribution<size_t>(0, str.size())(rng), string(rng() % 64, 'y'));
+    }
+    return str;
+}
+
+static void report(const char *what, const string &input, const string &expected, const string &actual) {
+    fprintf(stderr, "%s mismatch\n  input:    \"%s\"\n  expected: \"%s\"\n  actual:   \"%s\"\n", what,
+            input.c_str(), expected.c_str(), actual.c_str());
+}
+
+int main(const int argc, char **argv) {
+    const auto iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000ULL;
+    const auto seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : 20200101ULL;
+    mt19937_64 rng(seed);
+
+    size_t failures = 0;
+    for (unsigned long long i = 0; i < iterations && failures < 10; i++) {
+        const auto input = random_string(rng);
+        for (const auto escape_comma : {false, true}) {
+            const auto expected = reference_escape(input, escape_comma);
+            const auto actual = message::escape(input, escape_comma);
+            if (actual != expected) {
+                report(escape_comma ? "escape(escape_comma = true)" : "escape(escape_comma = false)", input,
+                       expected, actual);
+                failures++;
+            }
+            // round trip
+            if (message::unescape(actual) != reference_unescape(expected)) {
+                report("unescape(escape(...))", actual, reference_unescape(expected), message::unescape(actual));
+                failures++;
+            }
+        }
+        const auto expected = reference_unescape(input);
+        const auto actual = message::unescape(input);
+        if (actual != expected) {
+            report("unescape", input, expected, actual);
+            failures++;
+        }
+    }
+
+    if (failures > 0) {
+        fprintf(stderr, "%zu failure(s), seed %llu\n", failures, seed);
+        return 1;
+    }
+    printf("%llu random strings, escape and unescape match the reference (seed %llu)\n", iterations, seed);
+    return 0;
+}
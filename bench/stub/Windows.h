@@ -0,0 +1,60 @@
+#pragma once
+
+// Just enough of Windows.h to build the SDK on Linux for the benchmarks.
+// Nothing here talks to Windows: CoolQ is replaced by fake api::raw functions,
+// and the file and code page functions only fail, since the benchmarks don't use them.
+
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+
+#define __stdcall
+#define __declspec(x)
+#define __pragma(x)
+#define APIENTRY
+
+typedef int BOOL;
+typedef unsigned long DWORD;
+typedef void *HANDLE;
+typedef void *HMODULE;
+typedef void *LPVOID;
+typedef union {
+    struct {
+        DWORD LowPart;
+        long HighPart;
+    };
+    long long QuadPart;
+} LARGE_INTEGER;
+
+#define TRUE 1
+#define FALSE 0
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define GENERIC_READ 0x80000000u
+#define GENERIC_WRITE 0x40000000u
+#define FILE_SHARE_READ 1u
+#define FILE_SHARE_WRITE 2u
+#define FILE_SHARE_DELETE 4u
+#define OPEN_EXISTING 3u
+#define OPEN_ALWAYS 4u
+#define FILE_ATTRIBUTE_NORMAL 0x80u
+#define PAGE_READONLY 2u
+#define PAGE_READWRITE 4u
+#define FILE_MAP_WRITE 2u
+#define FILE_MAP_READ 4u
+#define DLL_PROCESS_DETACH 0
+#define DLL_PROCESS_ATTACH 1
+#define DLL_THREAD_ATTACH 2
+#define DLL_THREAD_DETACH 3
+
+inline HMODULE GetModuleHandleW(const wchar_t *) { return nullptr; }
+inline void *GetProcAddress(HMODULE, const char *) { return nullptr; }
+inline DWORD GetModuleFileNameW(HMODULE, wchar_t *, DWORD) { return 0; }
+inline int MultiByteToWideChar(unsigned, DWORD, const char *, int, wchar_t *, int) { return 0; }
+inline int WideCharToMultiByte(unsigned, DWORD, const wchar_t *, int, char *, int, const char *, BOOL *) { return 0; }
+inline HANDLE CreateFileW(const wchar_t *, DWORD, DWORD, void *, DWORD, DWORD, HANDLE) { return INVALID_HANDLE_VALUE; }
+inline BOOL GetFileSizeEx(HANDLE, LARGE_INTEGER *) { return FALSE; }
+inline HANDLE CreateFileMappingW(HANDLE, void *, DWORD, DWORD, DWORD, const wchar_t *) { return nullptr; }
+inline void *MapViewOfFile(HANDLE, DWORD, DWORD, DWORD, size_t) { return nullptr; }
+inline BOOL FlushViewOfFile(const void *, size_t) { return FALSE; }
+inline BOOL UnmapViewOfFile(const void *) { return FALSE; }
+inline BOOL CloseHandle(HANDLE) { return FALSE; }
@@ -0,0 +1,154 @@
+#include "./conversation.h"
+
+#ifdef CQ_HAS_COROUTINE
+
+#include <mutex>
+#include <unordered_map>
+
+#include "./logging.h"
+#include "./scheduler.h"
+
+using namespace std;
+
+namespace cq::conversation {
+    struct Key {
+        uint64_t chat;
+        int64_t user_id;
+
+        bool operator==(const Key &other) const { return chat == other.chat && user_id == other.user_id; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const noexcept {
+            return hash<uint64_t>()(key.chat) ^ (hash<int64_t>()(key.user_id) * 0x9E3779B97F4A7C15ULL);
+        }
+    };
+
+    static Key key_of(const Target &target) { return {target.chat_key(), target.user_id.value_or(0)}; }
+
+    class Registry {
+    public:
+        /**
+         * Start waiting, or return false if the timeout can't be scheduled, i.e. the scheduler is stopped.
+         */
+        bool add(MessageAwaiter *awaiter) {
+            const auto key = key_of(awaiter->target_);
+            MessageAwaiter *superseded = nullptr;
+            {
+                lock_guard<mutex> lock(mutex_);
+                const auto generation = ++generation_;
+                const auto timeout_task =
+                    scheduler::run_after(awaiter->timeout_, [this, key, generation] { expire(key, generation); });
+                if (!timeout_task) {
+                    return false;
+                }
+                auto &slot = waiting_[key];
+                if (slot.awaiter) {
+                    superseded = slot.awaiter;
+                    scheduler::cancel(slot.timeout_task);
+                }
+                slot.awaiter = awaiter;
+                slot.generation = generation;
+                slot.timeout_task = timeout_task;
+            }
+            if (superseded) {
+                superseded->__resume(nullopt);
+            }
+            return true;
+        }
+
+        MessageAwaiter *take(const Key &key) {
+            lock_guard<mutex> lock(mutex_);
+            const auto it = waiting_.find(key);
+            if (it == waiting_.end()) {
+                return nullptr;
+            }
+            const auto awaiter = it->second.awaiter;
+            scheduler::cancel(it->second.timeout_task);
+            waiting_.erase(it);
+            return awaiter;
+        }
+
+        size_t size() {
+            lock_guard<mutex> lock(mutex_);
+            return waiting_.size();
+        }
+
+        void stop() {
+            vector<MessageAwaiter *> cancelled;
+            {
+                lock_guard<mutex> lock(mutex_);
+                for (auto &item : waiting_) {
+                    scheduler::cancel(item.second.timeout_task);
+                    cancelled.push_back(item.second.awaiter);
+                }
+                waiting_.clear();
+            }
+            for (const auto awaiter : cancelled) {
+                awaiter->__resume(nullopt);
+            }
+        }
+
+    private:
+        struct Slot {
+            MessageAwaiter *awaiter = nullptr;
+            scheduler::TaskId timeout_task = 0;
+            uint64_t generation = 0; // tells a late timeout from the current wait
+        };
+
+        mutex mutex_;
+        uint64_t generation_ = 0;
+        unordered_map<Key, Slot, KeyHash> waiting_;
+
+        void expire(const Key &key, const uint64_t generation) {
+            MessageAwaiter *awaiter;
+            {
+                lock_guard<mutex> lock(mutex_);
+                const auto it = waiting_.find(key);
+                if (it == waiting_.end() || it->second.generation != generation) {
+                    return; // resumed or superseded in the meantime
+                }
+                awaiter = it->second.awaiter;
+                waiting_.erase(it);
+            }
+            awaiter->__resume(nullopt); // timed out
+        }
+    };
+
+    static Registry registry;
+
+    void Task::promise_type::unhandled_exception() noexcept {
+        try {
+            throw;
+        } catch (std::exception &e) {
+            logging::error("Conversation", string("conversation ended by an uncaught exception: ") + e.what());
+        } catch (...) {
+            logging::error("Conversation", "conversation ended by an uncaught exception");
+        }
+    }
+
+    bool MessageAwaiter::await_suspend(const coroutine_handle<> handle) {
+        handle_ = handle;
+        return registry.add(this); // if not waiting, the coroutine goes on right away, with nullopt
+    }
+
+    void MessageAwaiter::__resume(optional<event::MessageEvent> result) {
+        result_ = std::move(result);
+        handle_.resume();
+    }
+
+    bool __dispatch(const event::MessageEvent &e) {
+        const auto awaiter = registry.take(key_of(e.target));
+        if (!awaiter) {
+            return false;
+        }
+        awaiter->__resume(e);
+        return true;
+    }
+
+    void __stop() { registry.stop(); }
+
+    size_t waiting_count() { return registry.size(); }
+} // namespace cq::conversation
+
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "./common.h"
+
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define CQ_HAS_COROUTINE
+#endif
+
+#ifdef CQ_HAS_COROUTINE
+
+#include <chrono>
+#include <coroutine>
+
+#include "./event.h"
+#include "./target.h"
+
+/**
+ * Coroutine based multi-step conversations, available when compiled as C++20.
+ *
+ * A handler that returns conversation::Task can co_await conversation::next_message(...)
+ * to suspend until the given user sends the next message in the given chat:
+ *
+ *     conversation::Task confirm(const GroupMessageEvent &e) {
+ *         api::send_msg(e.target, "are you sure?");
+ *         const auto reply = co_await conversation::next_message(e.target, std::chrono::seconds(30));
+ *         if (reply && reply->raw_message == "yes") { ... }
+ *     }
+ *
+ * Suspended conversations are indexed by (chat, user), so each incoming message costs one hash lookup,
+ * no matter how many conversations are waiting. A message that resumes a conversation is not passed
+ * to the regular message handler.
+ */
+namespace cq::conversation {
+    /**
+     * A fire-and-forget coroutine, which starts running immediately.
+     */
+    struct Task {
+        struct promise_type {
+            Task get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+
+            /**
+             * Nobody awaits a Task, and rethrowing here would unwind into whoever resumed the coroutine
+             * (the event dispatcher or a scheduler worker), so the exception is logged, and the conversation ends.
+             */
+            void unhandled_exception() noexcept;
+        };
+    };
+
+    class MessageAwaiter {
+    public:
+        MessageAwaiter(const Target &target, const std::chrono::milliseconds timeout)
+            : target_(target), timeout_(timeout) {}
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        std::optional<event::MessageEvent> await_resume() { return std::move(result_); }
+
+        /**
+         * Resume the waiting coroutine. This is internally called by the dispatcher or on timeout,
+         * with nullopt if timed out, superseded by another wait, or the app is being disabled.
+         */
+        void __resume(std::optional<event::MessageEvent> result);
+
+    private:
+        Target target_;
+        std::chrono::milliseconds timeout_;
+        std::coroutine_handle<> handle_;
+        std::optional<event::MessageEvent> result_;
+
+        friend class Registry;
+    };
+
+    /**
+     * Wait for the next message from target.user_id in the chat of the target.
+     * The result is nullopt on timeout, or if another conversation starts waiting for the same user and chat.
+     *
+     * The timeout runs on the scheduler, so while the app is not enabled nothing is waited for,
+     * and the result is nullopt right away.
+     *
+     * The coroutine resumes on the thread that brings the result: the CoolQ event thread for a message,
+     * a scheduler worker for a timeout, or the thread that superseded or cancelled the wait.
+     * The code after co_await must be fine running on any of them, and shouldn't block a scheduler worker.
+     */
+    inline MessageAwaiter next_message(const Target &target,
+                                       const std::chrono::milliseconds timeout = std::chrono::minutes(1)) {
+        return MessageAwaiter(target, timeout);
+    }
+
+    /**
+     * Pass an incoming message to the conversation waiting for it, if any, and return true if there is one.
+     * This is internally called by the event layer.
+     */
+    bool __dispatch(const event::MessageEvent &e);
+
+    /**
+     * Cancel all waiting conversations, and their timeouts.
+     * This is internally called when the app is disabled or CoolQ is exiting.
+     */
+    void __stop();
+
+    /**
+     * The number of conversations currently waiting.
+     */
+    size_t waiting_count();
+} // namespace cq::conversation
+
+#endif
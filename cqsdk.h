@@ -4,14 +4,29 @@
 
 #include "./api.h"
 #include "./app.h"
+#include "./archive.h"
+#include "./batch.h"
+#include "./conversation.h"
 #include "./dir.h"
 #include "./enums.h"
 #include "./event.h"
+#include "./file_cache.h"
+#include "./flood_guard.h"
+#include "./group_tracker.h"
 #include "./logging.h"
+#include "./member_snapshot.h"
 #include "./menu.h"
 #include "./message.h"
+#include "./message_cache.h"
+#include "./pipeline.h"
+#include "./rate_limit.h"
+#include "./scheduler.h"
+#include "./snapshot_store.h"
+#include "./state_store.h"
 #include "./target.h"
+#include "./trace.h"
 #include "./types.h"
+#include "./watchdog.h"
 
 namespace cq {
     using event::Event;
@@ -31,5 +46,6 @@ namespace cq {
     using event::GroupRequestEvent;
 
     using message::Message;
+    using message::MessageBuilder;
     using message::MessageSegment;
 } // namespace cq
@@ -1,6 +1,8 @@
 #include "./dir.h"
 
 #include <filesystem>
+#include <mutex>
+#include <unordered_set>
 
 #include "./api.h"
 #include "./app.h"
@@ -10,11 +12,33 @@ using namespace std;
 namespace fs = std::filesystem;
 
 namespace cq::dir {
+    static mutex cache_mutex;
+    static string app_dir_cache; // empty if not resolved yet
+    static unordered_set<string> existing_dirs;
+
     static void create_dir_if_not_exists(const string &dir) {
+        {
+            lock_guard<mutex> lock(cache_mutex);
+            if (existing_dirs.count(dir) > 0) {
+                return;
+            }
+        }
+
         const auto ansi_dir = utils::ansi(dir);
         if (!fs::exists(ansi_dir)) {
             fs::create_directories(ansi_dir);
         }
+
+        lock_guard<mutex> lock(cache_mutex);
+        existing_dirs.insert(dir);
+    }
+
+    static string app_dir() {
+        lock_guard<mutex> lock(cache_mutex);
+        if (app_dir_cache.empty()) {
+            app_dir_cache = api::get_app_directory();
+        }
+        return app_dir_cache;
     }
 
     string root() {
@@ -27,16 +51,22 @@ namespace cq::dir {
 
     string app(const std::string &sub_dir_name) {
         if (sub_dir_name.empty()) {
-            return api::get_app_directory();
+            return app_dir();
         }
-        const auto dir = api::get_app_directory() + (sub_dir_name.empty() ? "" : sub_dir_name + "\\");
+        const auto dir = app_dir() + sub_dir_name + "\\";
         create_dir_if_not_exists(dir);
         return dir;
     }
 
     std::string app_per_account(const std::string &sub_dir_name) {
-        const auto dir = app(sub_dir_name) + to_string(api::get_login_user_id()) + "\\";
+        const auto dir = app(sub_dir_name) + to_string(app::login_user_id()) + "\\";
         create_dir_if_not_exists(dir);
         return dir;
     }
+
+    void __reset_cache() {
+        lock_guard<mutex> lock(cache_mutex);
+        app_dir_cache.clear();
+        existing_dirs.clear();
+    }
 } // namespace cq::dir
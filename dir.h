@@ -4,6 +4,18 @@
 
 namespace cq::dir {
     std::string root();
+
+    /**
+     * Get the app directory, or a sub directory of it, which is created if not exists.
+     * The app directory and the existence of created directories are resolved once and cached,
+     * until the app is enabled again.
+     */
     std::string app(const std::string &sub_dir_name = "");
     std::string app_per_account(const std::string &sub_dir_name);
+
+    /**
+     * Forget the cached paths.
+     * This is internally called when the app is enabled.
+     */
+    void __reset_cache();
 } // namespace cq::dir
@@ -1,8 +1,17 @@
 #include "./event.h"
 
+#include "./app.h"
+#include "./archive.h"
+#include "./conversation.h"
 #include "./def.h"
 #include "./exception.h"
-#include "./utils/function.h"
+#include "./flood_guard.h"
+#include "./group_tracker.h"
+#include "./message_cache.h"
+#include "./pipeline.h"
+#include "./trace.h"
+#include "./watchdog.h"
+#include "./utils/alloc_tracker.h"
 #include "./utils/string.h"
 
 namespace cq::event {
@@ -21,24 +30,105 @@ namespace cq::event {
 
 using namespace std;
 using namespace cq;
-using cq::utils::call_if_valid;
 using cq::utils::string_from_coolq;
 
+/**
+ * Find all "[CQ:at,qq=...]" in a raw message, in a single scan.
+ */
+static event::Mentions scan_mentions(const string &raw_message) {
+    static const string PREFIX = "[CQ:at,qq=";
+
+    event::Mentions mentions;
+    const auto login_user_id = app::login_user_id();
+    for (auto pos = raw_message.find(PREFIX); pos != string::npos; pos = raw_message.find(PREFIX, pos)) {
+        pos += PREFIX.size();
+        if (raw_message.compare(pos, 4, "all]") == 0) {
+            mentions.at_all = true;
+            continue;
+        }
+
+        int64_t user_id = 0;
+        auto end = pos;
+        while (end < raw_message.size() && raw_message[end] >= '0' && raw_message[end] <= '9') {
+            user_id = user_id * 10 + (raw_message[end++] - '0');
+        }
+        if (end == pos || end >= raw_message.size() || raw_message[end] != ']') {
+            continue; // not a valid at segment
+        }
+
+        if (!mentions.contains(user_id)) {
+            mentions.push_back(user_id);
+        }
+        if (user_id == login_user_id) {
+            mentions.at_me = true;
+        }
+    }
+    return mentions;
+}
+
+/**
+ * Pass a message event to the conversation waiting for it, if any.
+ */
+static bool resume_conversation([[maybe_unused]] const event::MessageEvent &e) {
+#ifdef CQ_HAS_COROUTINE
+    return conversation::__dispatch(e);
+#else
+    return false;
+#endif
+}
+
+/**
+ * Feed the started pipelines taking this type of event, and call the user handler, if any.
+ * The name is a string literal like "on_group_msg", for tracing and the watchdog.
+ */
+template <typename E>
+static void dispatch(const char *name, const function<void(const E &)> &handler, const E &e) {
+    CQ_ALLOC_COUNT_EVENT();
+    pipeline::Source<E>::__feed(e);
+    if (!handler) {
+        return;
+    }
+    CQ_ALLOC_SCOPE(HANDLER);
+    CQ_TRACE_SPAN(HANDLER, name);
+    int32_t message_id = 0;
+    string_view raw_message;
+    if constexpr (is_base_of_v<event::MessageEvent, E>) {
+        message_id = e.message_id;
+        raw_message = e.raw_message;
+    }
+    watchdog::Watch watch(name, e.target, message_id, raw_message);
+    if (config.coalesce_replies) {
+        message::SendCoalescer coalescer;
+        handler(e);
+    } else {
+        handler(e);
+    }
+}
+
 /**
  * Type=21 私聊消息
  * sub_type 子类型，11/来自好友 1/来自在线状态 2/来自群 3/来自讨论组
  */
 __CQ_EVENT(int32_t, cq_event_private_msg, 24)
 (int32_t sub_type, int32_t msg_id, int64_t from_qq, const char *msg, int32_t font) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::PrivateMessageEvent e;
     e.target = Target(from_qq);
     e.sub_type = static_cast<message::SubType>(sub_type);
     e.message_id = msg_id;
     e.raw_message = string_from_coolq(msg);
-    e.message = e.raw_message;
     e.font = font;
     e.user_id = from_qq;
-    call_if_valid(event::on_private_msg, e);
+    e.mentions = scan_mentions(e.raw_message);
+    message_cache.record_incoming(e);
+    if (!event::flood_guard.inspect(e, 0, from_qq)) {
+        return e.operation;
+    }
+    e.message = e.raw_message;
+    if (!resume_conversation(e)) {
+        dispatch("on_private_msg", event::on_private_msg, e);
+    }
     return e.operation;
 }
 
@@ -48,6 +138,8 @@ __CQ_EVENT(int32_t, cq_event_private_msg, 24)
 __CQ_EVENT(int32_t, cq_event_group_msg, 36)
 (int32_t sub_type, int32_t msg_id, int64_t from_group, int64_t from_qq, const char *from_anonymous, const char *msg,
  int32_t font) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::GroupMessageEvent e;
     e.target = Target(from_qq, from_group, Target::GROUP);
     e.sub_type = static_cast<message::SubType>(sub_type);
@@ -57,10 +149,8 @@ __CQ_EVENT(int32_t, cq_event_group_msg, 36)
     e.font = font;
     e.user_id = from_qq;
     e.group_id = from_group;
-    try {
-        e.anonymous = ObjectHelper::from_base64<Anonymous>(string_from_coolq(from_anonymous));
-    } catch (cq::exception::ParseError &) {
-    }
+    // from_anonymous is empty for normal messages, so don't pay for an exception here
+    ObjectHelper::try_from_base64(string_from_coolq(from_anonymous), e.anonymous);
 
     if (e.is_anonymous()) {
         // in CoolQ Air, there is a prefix in the message
@@ -70,9 +160,19 @@ __CQ_EVENT(int32_t, cq_event_group_msg, 36)
         }
     }
 
+    e.mentions = scan_mentions(e.raw_message);
+    message_archive.append(e);
+    message_cache.record_incoming(e);
+
+    if (!event::flood_guard.inspect(e, from_group, from_qq)) {
+        return e.operation;
+    }
+
     e.message = e.raw_message;
 
-    call_if_valid(event::on_group_msg, e);
+    if (!resume_conversation(e)) {
+        dispatch("on_group_msg", event::on_group_msg, e);
+    }
     return e.operation;
 }
 
@@ -81,6 +181,8 @@ __CQ_EVENT(int32_t, cq_event_group_msg, 36)
  */
 __CQ_EVENT(int32_t, cq_event_discuss_msg, 32)
 (int32_t sub_type, int32_t msg_id, int64_t from_discuss, int64_t from_qq, const char *msg, int32_t font) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::DiscussMessageEvent e;
     e.target = Target(from_qq, from_discuss, Target::DISCUSS);
     e.sub_type = static_cast<message::SubType>(sub_type);
@@ -90,7 +192,11 @@ __CQ_EVENT(int32_t, cq_event_discuss_msg, 32)
     e.font = font;
     e.user_id = from_qq;
     e.discuss_id = from_discuss;
-    call_if_valid(event::on_discuss_msg, e);
+    e.mentions = scan_mentions(e.raw_message);
+    message_cache.record_incoming(e);
+    if (!resume_conversation(e)) {
+        dispatch("on_discuss_msg", event::on_discuss_msg, e);
+    }
     return e.operation;
 }
 
@@ -99,17 +205,16 @@ __CQ_EVENT(int32_t, cq_event_discuss_msg, 32)
  */
 __CQ_EVENT(int32_t, cq_event_group_upload, 28)
 (int32_t sub_type, int32_t send_time, int64_t from_group, int64_t from_qq, const char *file) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::GroupUploadEvent e;
     e.target = Target(from_qq, from_group, Target::GROUP);
     e.time = send_time;
     e.sub_type = static_cast<notice::SubType>(sub_type);
-    try {
-        e.file = ObjectHelper::from_base64<File>(string_from_coolq(file));
-    } catch (cq::exception::ParseError &) {
-    }
+    ObjectHelper::try_from_base64(string_from_coolq(file), e.file);
     e.user_id = from_qq;
     e.group_id = from_group;
-    call_if_valid(event::on_group_upload, e);
+    dispatch("on_group_upload", event::on_group_upload, e);
     return e.operation;
 }
 
@@ -119,13 +224,16 @@ __CQ_EVENT(int32_t, cq_event_group_upload, 28)
  */
 __CQ_EVENT(int32_t, cq_event_group_admin, 24)
 (int32_t sub_type, int32_t send_time, int64_t from_group, int64_t being_operate_qq) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::GroupAdminEvent e;
     e.target = Target(being_operate_qq, from_group, Target::GROUP);
     e.time = send_time;
     e.sub_type = static_cast<notice::SubType>(sub_type);
     e.user_id = being_operate_qq;
     e.group_id = from_group;
-    call_if_valid(event::on_group_admin, e);
+    group_tracker.apply(e);
+    dispatch("on_group_admin", event::on_group_admin, e);
     return e.operation;
 }
 
@@ -137,6 +245,8 @@ __CQ_EVENT(int32_t, cq_event_group_admin, 24)
  */
 __CQ_EVENT(int32_t, cq_event_group_member_decrease, 32)
 (int32_t sub_type, int32_t send_time, int64_t from_group, int64_t from_qq, int64_t being_operate_qq) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::GroupMemberDecreaseEvent e;
     e.target = Target(being_operate_qq, from_group, Target::GROUP);
     e.time = send_time;
@@ -144,7 +254,8 @@ __CQ_EVENT(int32_t, cq_event_group_member_decrease, 32)
     e.user_id = being_operate_qq;
     e.group_id = from_group;
     e.operator_id = e.sub_type == notice::GROUP_MEMBER_DECREASE_LEAVE ? being_operate_qq : from_qq;
-    call_if_valid(event::on_group_member_decrease, e);
+    group_tracker.apply(e);
+    dispatch("on_group_member_decrease", event::on_group_member_decrease, e);
     return e.operation;
 }
 
@@ -156,6 +267,8 @@ __CQ_EVENT(int32_t, cq_event_group_member_decrease, 32)
  */
 __CQ_EVENT(int32_t, cq_event_group_member_increase, 32)
 (int32_t sub_type, int32_t send_time, int64_t from_group, int64_t from_qq, int64_t being_operate_qq) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::GroupMemberIncreaseEvent e;
     e.target = Target(being_operate_qq, from_group, Target::GROUP);
     e.time = send_time;
@@ -163,7 +276,8 @@ __CQ_EVENT(int32_t, cq_event_group_member_increase, 32)
     e.user_id = being_operate_qq;
     e.group_id = from_group;
     e.operator_id = from_qq;
-    call_if_valid(event::on_group_member_increase, e);
+    group_tracker.apply(e);
+    dispatch("on_group_member_increase", event::on_group_member_increase, e);
     return e.operation;
 }
 
@@ -177,6 +291,8 @@ __CQ_EVENT(int32_t, cq_event_group_member_increase, 32)
  */
 __CQ_EVENT(int32_t, cq_event_group_ban, 40)
 (int32_t sub_type, int32_t send_time, int64_t from_group, int64_t from_qq, int64_t being_operate_qq, int64_t duration) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::GroupBanEvent e;
     e.target = Target(being_operate_qq, from_group, Target::GROUP);
     e.time = send_time;
@@ -185,7 +301,8 @@ __CQ_EVENT(int32_t, cq_event_group_ban, 40)
     e.group_id = from_group;
     e.operator_id = from_qq;
     e.duration = duration;
-    call_if_valid(event::on_group_ban, e);
+    group_tracker.apply(e);
+    dispatch("on_group_ban", event::on_group_ban, e);
     return e.operation;
 }
 
@@ -194,12 +311,14 @@ __CQ_EVENT(int32_t, cq_event_group_ban, 40)
  */
 __CQ_EVENT(int32_t, cq_event_friend_add, 16)
 (int32_t sub_type, int32_t send_time, int64_t from_qq) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::FriendAddEvent e;
     e.target = Target(from_qq);
     e.time = send_time;
     e.sub_type = static_cast<notice::SubType>(sub_type);
     e.user_id = from_qq;
-    call_if_valid(event::on_friend_add, e);
+    dispatch("on_friend_add", event::on_friend_add, e);
     return e.operation;
 }
 
@@ -210,6 +329,8 @@ __CQ_EVENT(int32_t, cq_event_friend_add, 16)
  */
 __CQ_EVENT(int32_t, cq_event_add_friend_request, 24)
 (int32_t sub_type, int32_t send_time, int64_t from_qq, const char *msg, const char *response_flag) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::FriendRequestEvent e;
     e.target = Target(from_qq);
     e.time = send_time;
@@ -217,7 +338,7 @@ __CQ_EVENT(int32_t, cq_event_add_friend_request, 24)
     e.comment = string_from_coolq(msg);
     e.flag = string_from_coolq(response_flag);
     e.user_id = from_qq;
-    call_if_valid(event::on_friend_request, e);
+    dispatch("on_friend_request", event::on_friend_request, e);
     return e.operation;
 }
 
@@ -229,6 +350,8 @@ __CQ_EVENT(int32_t, cq_event_add_friend_request, 24)
  */
 __CQ_EVENT(int32_t, cq_event_add_group_request, 32)
 (int32_t sub_type, int32_t send_time, int64_t from_group, int64_t from_qq, const char *msg, const char *response_flag) {
+    CQ_ALLOC_SCOPE(EVENT);
+    CQ_TRACE_EVENT(__func__);
     event::GroupRequestEvent e;
     e.target = Target(from_qq, from_group, Target::GROUP);
     e.time = send_time;
@@ -237,6 +360,6 @@ __CQ_EVENT(int32_t, cq_event_add_group_request, 32)
     e.flag = string_from_coolq(response_flag);
     e.user_id = from_qq;
     e.group_id = from_group;
-    call_if_valid(event::on_group_request, e);
+    dispatch("on_group_request", event::on_group_request, e);
     return e.operation;
 }
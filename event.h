@@ -16,6 +16,46 @@ namespace cq::event {
         void block() const { operation = BLOCK; }
     };
 
+    /**
+     * Users mentioned (@) in a message, extracted from the raw message without parsing it.
+     */
+    struct Mentions {
+        static const size_t INLINE_CAPACITY = 4;
+
+        bool at_me = false;
+        bool at_all = false;
+
+        size_t size() const noexcept { return size_; }
+        bool empty() const noexcept { return size_ == 0; }
+
+        int64_t operator[](const size_t i) const {
+            return i < INLINE_CAPACITY ? inline_ids_[i] : overflow_ids_[i - INLINE_CAPACITY];
+        }
+
+        bool contains(const int64_t user_id) const {
+            for (size_t i = 0; i < size_; i++) {
+                if ((*this)[i] == user_id) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void push_back(const int64_t user_id) {
+            if (size_ < INLINE_CAPACITY) {
+                inline_ids_[size_] = user_id;
+            } else {
+                overflow_ids_.push_back(user_id);
+            }
+            size_++;
+        }
+
+    private:
+        int64_t inline_ids_[INLINE_CAPACITY]{};
+        std::vector<int64_t> overflow_ids_; // only used when there are more than INLINE_CAPACITY mentions
+        size_t size_ = 0;
+    };
+
     struct MessageEvent : Event {
         message::Type message_type;
         message::SubType sub_type;
@@ -23,6 +63,13 @@ namespace cq::event {
         std::string raw_message;
         message::Message message;
         int32_t font;
+
+        bool duplicate = false; // set by FloodGuard if enabled
+        bool flood = false; // set by FloodGuard if enabled
+
+        Mentions mentions;
+
+        bool is_at_me() const { return mentions.at_me; }
     };
 
     struct NoticeEvent : Event {
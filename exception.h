@@ -1,11 +1,13 @@
 #pragma once
 
-#include <exception>
+#include <stdexcept>
+#include <string>
 
 namespace cq::exception {
-    struct Exception : std::exception {
-        Exception(const char *what_arg) : exception(what_arg) {}
-        Exception(const std::string &what_arg) : exception(what_arg.c_str()) {}
+    // std::exception(const char *) is an MSVC extension, std::runtime_error keeps the message portably
+    struct Exception : std::runtime_error {
+        Exception(const char *what_arg) : runtime_error(what_arg) {}
+        Exception(const std::string &what_arg) : runtime_error(what_arg) {}
     };
 
     /**
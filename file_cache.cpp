@@ -0,0 +1,158 @@
+#include "./file_cache.h"
+
+#include <filesystem>
+
+#include "./dir.h"
+#include "./utils/string.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace cq {
+    FileCache file_cache;
+
+    api::Result<string> FileCache::try_get_image(const string &file) {
+        return resolve("image:" + file, "", [&] { return api::try_get_image(file); });
+    }
+
+    api::Result<string> FileCache::try_get_record(const string &file, const string &out_format, const bool full_path) {
+        // without full_path, CoolQ returns a path relative to its record directory
+        return resolve(string("record:") + (full_path ? "full:" : "") + out_format + ":" + file,
+                       full_path ? "" : dir::root() + "data\\record\\",
+                       [&] { return api::try_get_record(file, out_format, full_path); });
+    }
+
+    optional<string> FileCache::find_hit(const string &key) {
+        string path, local_path;
+        {
+            lock_guard<mutex> lock(mutex_);
+            const auto it = index_.find(key);
+            if (it == index_.end()) {
+                return nullopt;
+            }
+            path = it->second->path;
+            local_path = it->second->local_path;
+        }
+
+        // a system call, so not under the lock, which every lookup takes
+        error_code ec;
+        const auto exists = local_path.empty() || fs::exists(local_path, ec);
+
+        lock_guard<mutex> lock(mutex_);
+        const auto it = index_.find(key);
+        if (it == index_.end()) {
+            // evicted in the meantime, but the path is still good if the file is there
+            if (!exists) {
+                return nullopt;
+            }
+            stats_.hits++;
+            return path;
+        }
+        if (it->second->path != path) {
+            return nullopt; // replaced in the meantime, resolve() returns the new entry
+        }
+        const auto entry = it->second;
+        if (!exists) {
+            // the file is gone
+            disk_bytes_ -= entry->size;
+            lru_.erase(entry);
+            index_.erase(it);
+            return nullopt;
+        }
+        lru_.splice(lru_.begin(), lru_, entry);
+        stats_.hits++;
+        return path;
+    }
+
+    api::Result<string> FileCache::resolve(const string &key, const string &base_dir,
+                                           const function<api::Result<string>()> &fetch) {
+        if (auto hit = find_hit(key)) {
+            return std::move(*hit);
+        }
+
+        shared_future<api::Result<string>> future;
+        promise<api::Result<string>> promise;
+        {
+            unique_lock<mutex> lock(mutex_);
+            if (const auto it = index_.find(key); it != index_.end()) {
+                // resolved by another request since find_hit(), no need to check the file again
+                lru_.splice(lru_.begin(), lru_, it->second);
+                stats_.hits++;
+                return it->second->path;
+            }
+
+            if (const auto it = in_flight_.find(key); it != in_flight_.end()) {
+                future = it->second;
+                stats_.collapsed++;
+            } else {
+                future = promise.get_future().share();
+                in_flight_.emplace(key, future);
+                stats_.misses++;
+                lock.unlock();
+
+                optional<api::Result<string>> fetched;
+                try {
+                    fetched = fetch();
+                } catch (...) {
+                    lock.lock();
+                    in_flight_.erase(key);
+                    lock.unlock();
+                    promise.set_exception(current_exception());
+                    throw;
+                }
+                auto &result = *fetched;
+                Entry entry;
+                if (result) {
+                    entry.key = key;
+                    entry.path = *result;
+                    entry.local_path = utils::ansi(base_dir + entry.path);
+                    error_code ec;
+                    entry.size = fs::file_size(entry.local_path, ec);
+                    if (ec) {
+                        entry.local_path.clear();
+                        entry.size = 0;
+                    }
+                }
+
+                lock.lock();
+                in_flight_.erase(key);
+                if (result && index_.count(key) == 0) {
+                    disk_bytes_ += entry.size;
+                    lru_.push_front(std::move(entry));
+                    index_.emplace(key, lru_.begin());
+                    evict_locked();
+                }
+                lock.unlock();
+                promise.set_value(result);
+                return result;
+            }
+        }
+        return future.get();
+    }
+
+    void FileCache::evict_locked() {
+        // keep at least the newest entry, even if its file alone is over the disk bound
+        while (lru_.size() > 1 && (lru_.size() > options.capacity || disk_bytes_ > options.max_disk_bytes)) {
+            const auto &oldest = lru_.back();
+            disk_bytes_ -= oldest.size;
+            index_.erase(oldest.key);
+            lru_.pop_back();
+            stats_.evictions++;
+        }
+    }
+
+    FileCache::Stats FileCache::stats() const {
+        lock_guard<mutex> lock(mutex_);
+        auto stats = stats_;
+        stats.entries = lru_.size();
+        stats.disk_bytes = disk_bytes_;
+        return stats;
+    }
+
+    void FileCache::clear() {
+        lock_guard<mutex> lock(mutex_);
+        lru_.clear();
+        index_.clear();
+        disk_bytes_ = 0;
+    }
+} // namespace cq
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "./common.h"
+
+#include <future>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "./api.h"
+
+namespace cq {
+    /**
+     * A cache of resolved image and record files, in front of api::get_image and api::get_record.
+     *
+     * Entries are keyed by the "file" field of the CQ code (and the output format for records), and evicted in LRU
+     * order when there are more than "capacity" of them, or the files they point to take more than "max_disk_bytes".
+     * Evicted files are only forgotten, not deleted, since they belong to CoolQ.
+     * A hit whose file was removed in the meantime (e.g. by CoolQ's cleanup) is resolved again.
+     *
+     * Concurrent requests for the same file are collapsed into a single API call, whose result they all share.
+     * Failures are not cached.
+     */
+    class FileCache {
+    public:
+        struct Options {
+            size_t capacity = 1024;
+            uint64_t max_disk_bytes = 256 * 1024 * 1024;
+        };
+
+        struct Stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0; // API calls made
+            uint64_t collapsed = 0; // requests that waited for the API call of another one
+            uint64_t evictions = 0;
+            size_t entries = 0;
+            uint64_t disk_bytes = 0;
+        };
+
+        Options options;
+
+        api::Result<std::string> try_get_image(const std::string &file);
+        api::Result<std::string> try_get_record(const std::string &file, const std::string &out_format,
+                                                bool full_path = false);
+
+        std::string get_image(const std::string &file) noexcept(false) { return try_get_image(file).value(); }
+
+        std::string get_record(const std::string &file, const std::string &out_format,
+                               const bool full_path = false) noexcept(false) {
+            return try_get_record(file, out_format, full_path).value();
+        }
+
+        Stats stats() const;
+        void clear();
+
+    private:
+        struct Entry {
+            std::string key;
+            std::string path;
+            std::string local_path; // ANSI encoded, for the file system, empty if the size is unknown
+            uint64_t size = 0;
+        };
+
+        mutable std::mutex mutex_;
+        std::list<Entry> lru_; // most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+        std::unordered_map<std::string, std::shared_future<api::Result<std::string>>> in_flight_;
+        uint64_t disk_bytes_ = 0;
+        Stats stats_;
+
+        /**
+         * Get the path of a cached entry whose file still exists, checking the file without holding the lock.
+         */
+        std::optional<std::string> find_hit(const std::string &key);
+        api::Result<std::string> resolve(const std::string &key, const std::string &base_dir,
+                                         const std::function<api::Result<std::string>()> &fetch);
+        void evict_locked();
+    };
+
+    extern FileCache file_cache;
+} // namespace cq
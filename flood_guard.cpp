@@ -0,0 +1,78 @@
+#include "./flood_guard.h"
+
+#include <chrono>
+
+#include "./utils/hash.h"
+
+using namespace std;
+
+namespace cq::event {
+    FloodGuard flood_guard;
+
+    static uint32_t now_ms() {
+        return static_cast<uint32_t>(
+            chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    bool FloodGuard::inspect(MessageEvent &e, const int64_t group_id, const int64_t user_id) {
+        if (!options.enabled.load(memory_order_relaxed)) {
+            return true;
+        }
+
+        const auto is_group = group_id != 0;
+        const auto chat_id = is_group ? group_id : user_id;
+        const auto chat_hash = utils::mix64(static_cast<uint64_t>(chat_id) << 1 | is_group);
+        const auto content = utils::xxhash64(e.raw_message, utils::mix64(chat_hash ^ static_cast<uint64_t>(user_id)));
+        const auto time = max(now_ms(), uint32_t(1));
+        const auto window = static_cast<uint32_t>(options.window_ms.load(memory_order_relaxed));
+
+        const auto set = chat_hash % (RING_COUNT / RING_WAYS);
+        size_t same_content = 1, same_sender = 1; // including the current one
+        {
+            lock_guard<mutex> lock(locks_[set % LOCK_COUNT]);
+
+            // the ring of this chat, or the one to take over: an unused one, otherwise the least recently used
+            const auto ways = &rings_[set * RING_WAYS];
+            auto ring = &ways[0];
+            for (size_t i = 0; i < RING_WAYS; i++) {
+                auto &candidate = ways[i];
+                if (candidate.chat_id == chat_id && candidate.is_group == is_group) {
+                    ring = &candidate;
+                    break;
+                }
+                if (time - candidate.last_time > time - ring->last_time) {
+                    ring = &candidate; // also picks never used rings, whose last_time is 0
+                }
+            }
+            if (ring->chat_id != chat_id || ring->is_group != is_group) {
+                *ring = Ring();
+                ring->is_group = is_group;
+                ring->chat_id = chat_id;
+            }
+
+            for (const auto &fp : ring->slots) {
+                if (fp.time == 0 || time - fp.time > window || fp.user_id != user_id) {
+                    continue;
+                }
+                same_sender++;
+                if (fp.content == content) {
+                    same_content++;
+                }
+            }
+            ring->slots[ring->next] = {content, user_id, time};
+            ring->next = (ring->next + 1) % RING_SIZE;
+            ring->last_time = time;
+        }
+
+        e.duplicate = same_content >= options.duplicate_threshold.load(memory_order_relaxed);
+        e.flood = same_sender >= options.flood_threshold.load(memory_order_relaxed);
+        return options.action.load(memory_order_relaxed) == MARK || !(e.duplicate || e.flood);
+    }
+
+    void FloodGuard::reset() {
+        for (size_t i = 0; i < RING_COUNT; i++) {
+            lock_guard<mutex> lock(locks_[i / RING_WAYS % LOCK_COUNT]);
+            rings_[i] = Ring();
+        }
+    }
+} // namespace cq::event
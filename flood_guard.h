@@ -0,0 +1,73 @@
+#pragma once
+
+#include "./common.h"
+
+#include <atomic>
+#include <mutex>
+
+#include "./event.h"
+
+namespace cq::event {
+    /**
+     * Detect repeated and flooding messages before they reach the handlers.
+     *
+     * Recent messages are remembered as fingerprints in a fixed number of rings, one per chat (a group,
+     * or the private chat with a user), so the memory usage doesn't grow with the number of groups.
+     * The rings form a set-associative table: a chat can use any of the RING_WAYS rings of its set,
+     * and only takes over the least recently used one when all of them are in use by other active chats.
+     */
+    class FloodGuard {
+    public:
+        enum Action {
+            MARK, // set MessageEvent::duplicate / MessageEvent::flood, and call the handler as usual
+            DROP, // don't call the handler at all
+        };
+
+        // atomic, since they may be changed while messages are being inspected on other threads
+        struct Options {
+            std::atomic<bool> enabled{false};
+            std::atomic<Action> action{MARK};
+            std::atomic<int32_t> window_ms{10000}; // only messages in this window are taken into account
+            std::atomic<size_t> duplicate_threshold{2}; // the same content from the same user, this many times or more
+            std::atomic<size_t> flood_threshold{8}; // any content from the same user, this many times or more
+        };
+
+        Options options;
+
+        /**
+         * Inspect a message, and return false if it should be dropped.
+         * group_id is 0 for private messages.
+         */
+        bool inspect(MessageEvent &e, int64_t group_id, int64_t user_id);
+
+        /**
+         * Forget all the fingerprints.
+         */
+        void reset();
+
+        static const size_t RING_COUNT = 4096;
+        static const size_t RING_WAYS = 4;
+        static const size_t RING_SIZE = 32;
+        static const size_t LOCK_COUNT = 64;
+
+    private:
+        struct Fingerprint {
+            uint64_t content = 0; // hash of (chat, user, raw_message)
+            int64_t user_id = 0;
+            uint32_t time = 0; // milliseconds, wraps around every ~49 days, 0 for an empty slot
+        };
+
+        struct Ring {
+            bool is_group = false; // the owner chat, a group or the private chat with a user
+            int64_t chat_id = 0; // 0 if not owned
+            uint32_t last_time = 0;
+            Fingerprint slots[RING_SIZE];
+            size_t next = 0;
+        };
+
+        Ring rings_[RING_COUNT];
+        std::mutex locks_[LOCK_COUNT];
+    };
+
+    extern FloodGuard flood_guard;
+} // namespace cq::event
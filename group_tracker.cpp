@@ -0,0 +1,253 @@
+#include "./group_tracker.h"
+
+#include <mutex>
+
+#include "./api.h"
+#include "./app.h"
+
+using namespace std;
+
+namespace cq {
+    GroupTracker group_tracker;
+
+    void GroupTracker::load() {
+        auto groups = api::get_group_list();
+        full_loads_++;
+
+        unique_lock<shared_mutex> lock(mutex_);
+        groups_.clear();
+        for (auto &group : groups) {
+            const auto group_id = group.group_id;
+            groups_[group_id].info = std::move(group);
+        }
+        loaded_ = true;
+    }
+
+    vector<Group> GroupTracker::groups() const {
+        shared_lock<shared_mutex> lock(mutex_);
+        vector<Group> result;
+        result.reserve(groups_.size());
+        for (const auto &item : groups_) {
+            result.push_back(item.second.info);
+        }
+        return result;
+    }
+
+    bool GroupTracker::in_group(const int64_t group_id) const {
+        shared_lock<shared_mutex> lock(mutex_);
+        return groups_.count(group_id) > 0;
+    }
+
+    optional<GroupRole> GroupTracker::role_of(const int64_t group_id, const int64_t user_id) {
+        optional<GroupRole> role;
+        with_members(group_id, [&](const GroupMemberSnapshot &members) { role = members.role_of(user_id); });
+        return role;
+    }
+
+    bool GroupTracker::is_banned(const int64_t group_id, const int64_t user_id) const {
+        shared_lock<shared_mutex> lock(mutex_);
+        const auto it = groups_.find(group_id);
+        if (it == groups_.end()) {
+            return false;
+        }
+        if (it->second.whole_banned) {
+            return true;
+        }
+        const auto ban = it->second.banned_until.find(user_id);
+        return ban != it->second.banned_until.end() && ban->second > time(nullptr);
+    }
+
+    bool GroupTracker::ensure_members(const int64_t group_id) {
+        uint64_t version;
+        {
+            shared_lock<shared_mutex> lock(mutex_);
+            const auto it = groups_.find(group_id);
+            if (it == groups_.end()) {
+                return false;
+            }
+            if (it->second.members && !it->second.stale) {
+                return true;
+            }
+            version = it->second.version;
+        }
+
+        // fetch without holding the lock, so that events and readers of other groups are not blocked
+        auto members = api::try_get_group_member_list(group_id);
+        if (!members) {
+            return false;
+        }
+        group_reloads_++;
+
+        unique_lock<shared_mutex> lock(mutex_);
+        const auto it = groups_.find(group_id);
+        if (it == groups_.end()) {
+            return false; // we left the group in the meantime
+        }
+        it->second.members = make_unique<GroupMemberSnapshot>(group_id, *members);
+        // an event during the fetch may or may not be reflected in the list, so fetch again next time
+        it->second.stale = it->second.version != version;
+        return true;
+    }
+
+    void GroupTracker::track_group(const int64_t group_id) {
+        // we've joined a new group
+        const auto info = api::try_get_group_info(group_id);
+        unique_lock<shared_mutex> lock(mutex_);
+        auto &group = groups_[group_id];
+        if (info) {
+            group.info = *info;
+        } else {
+            group.info.group_id = group_id;
+        }
+        group.stale = true;
+    }
+
+    GroupTracker::Tracked *GroupTracker::find_for_event(const int64_t group_id) {
+        const auto it = groups_.find(group_id);
+        if (it == groups_.end()) {
+            return nullptr;
+        }
+        it->second.version++;
+        return &it->second;
+    }
+
+    void GroupTracker::mark_inconsistent(Tracked &group) {
+        group.stale = true;
+        inconsistencies_++;
+    }
+
+    void GroupTracker::apply(const event::GroupMemberIncreaseEvent &e) {
+        if (!options.enabled) {
+            return;
+        }
+        if (e.user_id == app::login_user_id()) {
+            track_group(e.group_id);
+            return;
+        }
+
+        // only fetch the new member if there are up-to-date members to add them to,
+        // and not under the lock, since it blocks on the API
+        bool wants_member;
+        {
+            shared_lock<shared_mutex> lock(mutex_);
+            const auto it = groups_.find(e.group_id);
+            wants_member = it != groups_.end() && it->second.members && !it->second.stale;
+        }
+        // if not fetched, or if that fails, keep the member anyway, with what we know from the event
+        GroupMember member;
+        member.group_id = e.group_id;
+        member.user_id = e.user_id;
+        member.join_time = e.time;
+        if (wants_member) {
+            if (auto info = api::try_get_group_member_info(e.group_id, e.user_id)) {
+                member = std::move(*info);
+            }
+        }
+
+        unique_lock<shared_mutex> lock(mutex_);
+        const auto group = find_for_event(e.group_id);
+        if (!group) {
+            if (loaded_) {
+                lock.unlock();
+                inconsistencies_++;
+                track_group(e.group_id); // a group we didn't know we were in
+            }
+            return;
+        }
+        if (group->members) {
+            if (group->members->contains(e.user_id)) {
+                inconsistencies_++; // we missed them leaving, but the upsert below fixes that
+            }
+            group->members->upsert(member);
+        }
+        group->info.member_count++;
+        deltas_applied_++;
+    }
+
+    void GroupTracker::apply(const event::GroupMemberDecreaseEvent &e) {
+        if (!options.enabled) {
+            return;
+        }
+        // may call the API the first time, so not under the lock
+        const auto left_by_ourselves =
+            e.sub_type == notice::GROUP_MEMBER_DECREASE_KICK_ME || e.user_id == app::login_user_id();
+
+        unique_lock<shared_mutex> lock(mutex_);
+        if (left_by_ourselves) {
+            groups_.erase(e.group_id); // kicked, or left by ourselves
+            deltas_applied_++;
+            return;
+        }
+
+        const auto group = find_for_event(e.group_id);
+        if (!group) {
+            return;
+        }
+        if (group->members && !group->members->remove(e.user_id)) {
+            mark_inconsistent(*group);
+            return;
+        }
+        group->banned_until.erase(e.user_id);
+        group->info.member_count = max(group->info.member_count - 1, 0);
+        deltas_applied_++;
+    }
+
+    void GroupTracker::apply(const event::GroupAdminEvent &e) {
+        if (!options.enabled) {
+            return;
+        }
+        unique_lock<shared_mutex> lock(mutex_);
+        const auto group = find_for_event(e.group_id);
+        if (!group) {
+            return;
+        }
+        const auto role = e.sub_type == notice::GROUP_ADMIN_SET ? GroupRole::ADMIN : GroupRole::MEMBER;
+        if (group->members && !group->members->set_role(e.user_id, role)) {
+            mark_inconsistent(*group);
+            return;
+        }
+        deltas_applied_++;
+    }
+
+    void GroupTracker::apply(const event::GroupBanEvent &e) {
+        if (!options.enabled) {
+            return;
+        }
+        unique_lock<shared_mutex> lock(mutex_);
+        const auto group = find_for_event(e.group_id);
+        if (!group) {
+            return;
+        }
+
+        const auto ban = e.sub_type == notice::GROUP_BAN_BAN;
+        if (e.user_id == 0) {
+            group->whole_banned = ban; // the whole group
+        } else {
+            if (group->members && !group->members->contains(e.user_id)) {
+                mark_inconsistent(*group);
+                return;
+            }
+            if (ban) {
+                group->banned_until[e.user_id] = e.time + e.duration;
+            } else {
+                group->banned_until.erase(e.user_id);
+            }
+        }
+        deltas_applied_++;
+    }
+
+    GroupTracker::Stats GroupTracker::stats() const {
+        Stats stats;
+        stats.full_loads = full_loads_.load();
+        stats.group_reloads = group_reloads_.load();
+        stats.deltas_applied = deltas_applied_.load();
+        stats.inconsistencies = inconsistencies_.load();
+        return stats;
+    }
+
+    void GroupTracker::reset() {
+        unique_lock<shared_mutex> lock(mutex_);
+        groups_.clear();
+        loaded_ = false;
+    }
+} // namespace cq
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "./common.h"
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "./event.h"
+#include "./member_snapshot.h"
+#include "./types.h"
+
+namespace cq {
+    /**
+     * An up-to-date view of our groups and their members, built once and then kept in sync
+     * by the group notice events, instead of reloading everything periodically.
+     *
+     * The member list of a group is loaded on first access. When an event doesn't match what we know
+     * (e.g. a member we've never seen leaves), only that group is fetched again, on the next access.
+     */
+    class GroupTracker {
+    public:
+        struct Options {
+            bool enabled = false;
+        };
+
+        struct Stats {
+            uint64_t full_loads = 0; // load() calls, fetching the group list
+            uint64_t group_reloads = 0; // member lists fetched, including the first time for each group
+            uint64_t deltas_applied = 0; // events applied incrementally
+            uint64_t inconsistencies = 0; // events that caused a group to be fetched again
+
+            /**
+             * Each applied event would otherwise need the group to be reloaded.
+             */
+            uint64_t reloads_avoided() const noexcept { return deltas_applied; }
+        };
+
+        Options options;
+
+        /**
+         * Fetch the group list, and forget all member lists.
+         */
+        void load() noexcept(false);
+
+        std::vector<Group> groups() const;
+        bool in_group(int64_t group_id) const;
+
+        /**
+         * Call f(const GroupMemberSnapshot &) with the members of the group, which are fetched first if needed.
+         * Return false if we are not in the group, or the members can't be fetched.
+         * f is called under a shared lock, so don't call back into the tracker from it.
+         */
+        template <typename F>
+        bool with_members(const int64_t group_id, F f) {
+            if (!ensure_members(group_id)) {
+                return false;
+            }
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            const auto it = groups_.find(group_id);
+            if (it == groups_.end() || !it->second.members) {
+                return false;
+            }
+            f(static_cast<const GroupMemberSnapshot &>(*it->second.members));
+            return true;
+        }
+
+        std::optional<GroupRole> role_of(int64_t group_id, int64_t user_id);
+
+        /**
+         * Check if the user is banned in the group, or the whole group is banned.
+         */
+        bool is_banned(int64_t group_id, int64_t user_id) const;
+
+        /**
+         * Apply the group notice events. This is internally called by the event layer, when enabled.
+         */
+        void apply(const event::GroupMemberIncreaseEvent &e);
+        void apply(const event::GroupMemberDecreaseEvent &e);
+        void apply(const event::GroupAdminEvent &e);
+        void apply(const event::GroupBanEvent &e);
+
+        Stats stats() const;
+
+        /**
+         * Forget everything. This is internally called when the app is enabled, since the login user may change.
+         */
+        void reset();
+
+    private:
+        struct Tracked {
+            Group info;
+            std::unique_ptr<GroupMemberSnapshot> members; // nullptr if not loaded yet
+            bool stale = false; // members need to be fetched again
+            uint64_t version = 0; // bumped by each event, to detect events during a fetch
+            bool whole_banned = false;
+            std::unordered_map<int64_t, int64_t> banned_until; // user id -> unix time
+        };
+
+        mutable std::shared_mutex mutex_;
+        std::unordered_map<int64_t, Tracked> groups_;
+        bool loaded_ = false;
+
+        std::atomic<uint64_t> full_loads_{0};
+        std::atomic<uint64_t> group_reloads_{0};
+        std::atomic<uint64_t> deltas_applied_{0};
+        std::atomic<uint64_t> inconsistencies_{0};
+
+        bool ensure_members(int64_t group_id);
+        void track_group(int64_t group_id);
+        Tracked *find_for_event(int64_t group_id);
+        void mark_inconsistent(Tracked &group);
+    };
+
+    extern GroupTracker group_tracker;
+} // namespace cq
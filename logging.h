@@ -18,7 +18,7 @@ namespace cq::logging {
 
     inline int32_t log(const Level level, const std::string &tag, const std::string &msg) {
         return api::raw::CQ_addLog(
-            app::auth_code, level, utils::string_to_coolq(tag).c_str(), utils::string_to_coolq(msg).c_str());
+            app::auth_code, level, utils::string_to_coolq_arg(tag), utils::string_to_coolq_arg(msg));
     }
 
     inline void debug(const std::string &tag, const std::string &msg) { log(DEBUG, tag, msg); }
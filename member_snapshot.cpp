@@ -0,0 +1,319 @@
+#include "./member_snapshot.h"
+
+#include "./api.h"
+#include "./app.h"
+
+using namespace std;
+
+namespace cq {
+    static bool test_bit(const vector<uint64_t> &bits, const size_t i) {
+        return i / 64 < bits.size() && (bits[i / 64] >> (i % 64) & 1);
+    }
+
+    static void assign_bit(vector<uint64_t> &bits, const size_t i, const bool value) {
+        if (i / 64 >= bits.size()) {
+            bits.resize(i / 64 + 1);
+        }
+        if (value) {
+            bits[i / 64] |= uint64_t(1) << (i % 64);
+        } else {
+            bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+        }
+    }
+
+    static vector<int64_t> rows_of_bits(const vector<uint64_t> &bits, const vector<int64_t> &user_ids) {
+        vector<int64_t> result;
+        for (size_t w = 0; w < bits.size(); w++) {
+            for (auto word = bits[w]; word; word &= word - 1) {
+                auto b = 0;
+                while (!(word >> b & 1)) b++;
+                result.push_back(user_ids[w * 64 + b]);
+            }
+        }
+        return result;
+    }
+
+    GroupMemberSnapshot::GroupMemberSnapshot(const int64_t group_id, const vector<GroupMember> &members)
+        : group_id_(group_id) {
+        user_ids_.reserve(members.size());
+        roles_.reserve(members.size());
+        join_times_.reserve(members.size());
+        last_sent_times_.reserve(members.size());
+        cards_.reserve(members.size());
+        details_.reserve(members.size());
+        row_of_.reserve(members.size());
+        for (const auto &member : members) {
+            upsert(member);
+        }
+    }
+
+    GroupMemberSnapshot GroupMemberSnapshot::load(const int64_t group_id) {
+        return GroupMemberSnapshot(group_id, api::get_group_member_list(group_id));
+    }
+
+    optional<GroupMember> GroupMemberSnapshot::get(const int64_t user_id) const {
+        if (const auto it = row_of_.find(user_id); it != row_of_.end()) {
+            const auto row = it->second;
+            const auto &details = details_[row];
+            GroupMember member;
+            member.group_id = group_id_;
+            member.user_id = user_ids_[row];
+            member.nickname = details.nickname;
+            member.card = cards_[row];
+            member.sex = details.sex;
+            member.age = details.age;
+            member.area = details.area;
+            member.join_time = join_times_[row];
+            member.last_sent_time = last_sent_times_[row];
+            member.level = details.level;
+            member.role = roles_[row];
+            member.unfriendly = details.unfriendly;
+            member.title = details.title;
+            member.title_expire_time = details.title_expire_time;
+            member.card_changeable = details.card_changeable;
+            return member;
+        }
+        return nullopt;
+    }
+
+    optional<GroupRole> GroupMemberSnapshot::role_of(const int64_t user_id) const {
+        if (const auto it = row_of_.find(user_id); it != row_of_.end()) {
+            return roles_[it->second];
+        }
+        return nullopt;
+    }
+
+    bool GroupMemberSnapshot::is_admin(const int64_t user_id) const {
+        if (const auto it = row_of_.find(user_id); it != row_of_.end()) {
+            return test_bit(admin_bits_, it->second) || test_bit(owner_bits_, it->second);
+        }
+        return false;
+    }
+
+    vector<int64_t> GroupMemberSnapshot::with_role(const GroupRole role) const {
+        switch (role) {
+        case GroupRole::ADMIN:
+            return rows_of_bits(admin_bits_, user_ids_);
+        case GroupRole::OWNER:
+            return rows_of_bits(owner_bits_, user_ids_);
+        default:
+            break;
+        }
+        vector<int64_t> result;
+        for (size_t i = 0; i < roles_.size(); i++) {
+            if (roles_[i] == role) {
+                result.push_back(user_ids_[i]);
+            }
+        }
+        return result;
+    }
+
+    vector<int64_t> GroupMemberSnapshot::find_by_card(const string &keyword) const {
+        vector<int64_t> result;
+        for (size_t i = 0; i < cards_.size(); i++) {
+            if (cards_[i].find(keyword) != string::npos) {
+                result.push_back(user_ids_[i]);
+            }
+        }
+        return result;
+    }
+
+    vector<int64_t> GroupMemberSnapshot::inactive_since(const int32_t time) const {
+        if (by_last_sent_dirty_) {
+            by_last_sent_.resize(user_ids_.size());
+            for (size_t i = 0; i < by_last_sent_.size(); i++) {
+                by_last_sent_[i] = static_cast<uint32_t>(i);
+            }
+            sort(by_last_sent_.begin(), by_last_sent_.end(), [this](const uint32_t a, const uint32_t b) {
+                return last_sent_times_[a] < last_sent_times_[b];
+            });
+            by_last_sent_dirty_ = false;
+        }
+
+        vector<int64_t> result;
+        for (const auto row : by_last_sent_) {
+            if (last_sent_times_[row] >= time) {
+                break;
+            }
+            result.push_back(user_ids_[row]);
+        }
+        return result;
+    }
+
+    void GroupMemberSnapshot::upsert(const GroupMember &member) {
+        Details details;
+        details.nickname = member.nickname;
+        details.sex = member.sex;
+        details.age = member.age;
+        details.area = member.area;
+        details.level = member.level;
+        details.unfriendly = member.unfriendly;
+        details.title = member.title;
+        details.title_expire_time = member.title_expire_time;
+        details.card_changeable = member.card_changeable;
+
+        size_t row;
+        if (const auto it = row_of_.find(member.user_id); it != row_of_.end()) {
+            row = it->second;
+            roles_[row] = member.role;
+            join_times_[row] = member.join_time;
+            last_sent_times_[row] = member.last_sent_time;
+            cards_[row] = member.card;
+            details_[row] = std::move(details);
+        } else {
+            row = user_ids_.size();
+            user_ids_.push_back(member.user_id);
+            roles_.push_back(member.role);
+            join_times_.push_back(member.join_time);
+            last_sent_times_.push_back(member.last_sent_time);
+            cards_.push_back(member.card);
+            details_.push_back(std::move(details));
+            row_of_.emplace(member.user_id, row);
+        }
+        set_role_bits(row, member.role);
+        by_last_sent_dirty_ = true;
+    }
+
+    bool GroupMemberSnapshot::remove(const int64_t user_id) {
+        const auto it = row_of_.find(user_id);
+        if (it == row_of_.end()) {
+            return false;
+        }
+
+        // move the last row into the hole, so that the columns stay contiguous
+        const auto row = it->second;
+        const auto last = user_ids_.size() - 1;
+        row_of_.erase(it);
+        if (row != last) {
+            user_ids_[row] = user_ids_[last];
+            roles_[row] = roles_[last];
+            join_times_[row] = join_times_[last];
+            last_sent_times_[row] = last_sent_times_[last];
+            cards_[row] = std::move(cards_[last]);
+            details_[row] = std::move(details_[last]);
+            row_of_[user_ids_[row]] = row;
+            set_role_bits(row, roles_[row]);
+        }
+        set_role_bits(last, GroupRole::MEMBER);
+
+        user_ids_.pop_back();
+        roles_.pop_back();
+        join_times_.pop_back();
+        last_sent_times_.pop_back();
+        cards_.pop_back();
+        details_.pop_back();
+        by_last_sent_dirty_ = true;
+        return true;
+    }
+
+    bool GroupMemberSnapshot::set_role(const int64_t user_id, const GroupRole role) {
+        const auto it = row_of_.find(user_id);
+        if (it == row_of_.end()) {
+            return false;
+        }
+        roles_[it->second] = role;
+        set_role_bits(it->second, role);
+        return true;
+    }
+
+    bool GroupMemberSnapshot::touch(const int64_t user_id, const int32_t last_sent_time) {
+        const auto it = row_of_.find(user_id);
+        if (it == row_of_.end()) {
+            return false;
+        }
+        const auto row = static_cast<uint32_t>(it->second);
+        if (!by_last_sent_dirty_ && last_sent_times_[row] != last_sent_time) {
+            move_in_by_last_sent(row, last_sent_time);
+        }
+        last_sent_times_[row] = last_sent_time;
+        return true;
+    }
+
+    void GroupMemberSnapshot::apply(const event::GroupMemberIncreaseEvent &e) {
+        if (e.group_id != group_id_) {
+            return;
+        }
+        if (e.user_id == app::login_user_id()) {
+            // we (re)joined, so load the whole list again, and stay invalidated if that fails
+            clear();
+            invalidated_ = true;
+            if (auto members = api::try_get_group_member_list(group_id_)) {
+                for (const auto &member : *members) {
+                    upsert(member);
+                }
+                invalidated_ = false;
+            }
+            return;
+        }
+        if (invalidated_) {
+            return; // we are not in the group, and the whole list is loaded when we rejoin
+        }
+        // if fetching fails, keep the member anyway, with what we know from the event
+        GroupMember member;
+        member.group_id = e.group_id;
+        member.user_id = e.user_id;
+        member.join_time = e.time;
+        if (auto info = api::try_get_group_member_info(e.group_id, e.user_id)) {
+            member = std::move(*info);
+        }
+        upsert(member);
+    }
+
+    void GroupMemberSnapshot::apply(const event::GroupMemberDecreaseEvent &e) {
+        if (e.group_id != group_id_) {
+            return;
+        }
+        if (e.sub_type == notice::GROUP_MEMBER_DECREASE_KICK_ME || e.user_id == app::login_user_id()) {
+            clear(); // we are no longer in the group, so nothing here can be trusted
+            invalidated_ = true;
+            return;
+        }
+        remove(e.user_id);
+    }
+
+    void GroupMemberSnapshot::apply(const event::GroupAdminEvent &e) {
+        if (e.group_id != group_id_) {
+            return;
+        }
+        set_role(e.user_id, e.sub_type == notice::GROUP_ADMIN_SET ? GroupRole::ADMIN : GroupRole::MEMBER);
+    }
+
+    void GroupMemberSnapshot::clear() {
+        user_ids_.clear();
+        roles_.clear();
+        join_times_.clear();
+        last_sent_times_.clear();
+        cards_.clear();
+        details_.clear();
+        row_of_.clear();
+        admin_bits_.clear();
+        owner_bits_.clear();
+        by_last_sent_.clear();
+        by_last_sent_dirty_ = true;
+    }
+
+    void GroupMemberSnapshot::move_in_by_last_sent(const uint32_t row, const int32_t new_time) {
+        const auto old_time = last_sent_times_[row];
+        const auto by_time = [this](const uint32_t r, const int32_t time) { return last_sent_times_[r] < time; };
+        const auto begin = by_last_sent_.begin(), end = by_last_sent_.end();
+
+        auto pos = lower_bound(begin, end, old_time, by_time);
+        while (*pos != row) {
+            ++pos; // among the rows with the same time
+        }
+        if (new_time > old_time) {
+            const auto to = upper_bound(pos + 1, end, new_time, [this](const int32_t time, const uint32_t r) {
+                return time < last_sent_times_[r];
+            });
+            rotate(pos, pos + 1, to);
+        } else {
+            const auto to = lower_bound(begin, pos, new_time, by_time);
+            rotate(to, pos, pos + 1);
+        }
+    }
+
+    void GroupMemberSnapshot::set_role_bits(const size_t row, const GroupRole role) {
+        assign_bit(admin_bits_, row, role == GroupRole::ADMIN);
+        assign_bit(owner_bits_, row, role == GroupRole::OWNER);
+    }
+} // namespace cq
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "./common.h"
+
+#include <unordered_map>
+
+#include "./event.h"
+#include "./types.h"
+
+namespace cq {
+    /**
+     * An indexed snapshot of a group's member list.
+     *
+     * Frequently scanned fields are stored column by column, so that role checks, card searches
+     * and inactivity sweeps don't need to walk through whole GroupMember objects.
+     */
+    class GroupMemberSnapshot {
+    public:
+        GroupMemberSnapshot() = default;
+        GroupMemberSnapshot(int64_t group_id, const std::vector<GroupMember> &members);
+
+        /**
+         * Build a snapshot from api::get_group_member_list().
+         */
+        static GroupMemberSnapshot load(int64_t group_id) noexcept(false);
+
+        int64_t group_id() const noexcept { return group_id_; }
+        size_t size() const noexcept { return user_ids_.size(); }
+        bool empty() const noexcept { return user_ids_.empty(); }
+
+        bool contains(const int64_t user_id) const { return row_of_.count(user_id) > 0; }
+        std::optional<GroupMember> get(int64_t user_id) const;
+        std::optional<GroupRole> role_of(int64_t user_id) const;
+
+        /**
+         * Check if the user is an admin or the owner of the group.
+         */
+        bool is_admin(int64_t user_id) const;
+
+        std::vector<int64_t> with_role(GroupRole role) const;
+
+        /**
+         * Find members whose card contains the given keyword.
+         */
+        std::vector<int64_t> find_by_card(const std::string &keyword) const;
+
+        /**
+         * Find members who haven't sent any message since the given time, the most inactive ones first.
+         */
+        std::vector<int64_t> inactive_since(int32_t time) const;
+
+        /**
+         * Insert a member, or replace the existing one with the same user id.
+         */
+        void upsert(const GroupMember &member);
+
+        bool remove(int64_t user_id);
+        bool set_role(int64_t user_id, GroupRole role);
+        bool touch(int64_t user_id, int32_t last_sent_time);
+
+        /**
+         * Apply member changes from notice events, instead of reloading the whole list.
+         * Events of other groups are ignored.
+         */
+        void apply(const event::GroupMemberIncreaseEvent &e);
+        void apply(const event::GroupMemberDecreaseEvent &e);
+        void apply(const event::GroupAdminEvent &e);
+
+        /**
+         * Check if the snapshot was invalidated, because we left or were kicked from the group.
+         * An invalidated snapshot is empty. It's loaded again when we rejoin the group,
+         * and stays invalidated if that fails.
+         */
+        bool invalidated() const noexcept { return invalidated_; }
+
+    private:
+        // the fields of GroupMember that don't have their own column
+        struct Details {
+            std::string nickname;
+            Sex sex = Sex::UNKNOWN;
+            int32_t age = 0;
+            std::string area;
+            std::string level;
+            bool unfriendly = false;
+            std::string title;
+            int32_t title_expire_time = 0;
+            bool card_changeable = false;
+        };
+
+        int64_t group_id_ = 0;
+        bool invalidated_ = false;
+
+        std::vector<int64_t> user_ids_;
+        std::vector<GroupRole> roles_;
+        std::vector<int32_t> join_times_;
+        std::vector<int32_t> last_sent_times_;
+        std::vector<std::string> cards_;
+        std::vector<Details> details_; // rarely used fields, only touched by get()
+
+        std::unordered_map<int64_t, size_t> row_of_;
+        std::vector<uint64_t> admin_bits_;
+        std::vector<uint64_t> owner_bits_;
+
+        // rows sorted by last_sent_time, rebuilt lazily after rows are added or removed, and kept sorted by touch()
+        mutable std::vector<uint32_t> by_last_sent_;
+        mutable bool by_last_sent_dirty_ = true;
+
+        // move a row to its place in by_last_sent_ for the new time, before last_sent_times_ is updated
+        void move_in_by_last_sent(uint32_t row, int32_t new_time);
+        void set_role_bits(size_t row, GroupRole role);
+        void clear();
+    };
+} // namespace cq
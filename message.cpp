@@ -1,29 +1,158 @@
 #include "./message.h"
 
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CQ_MESSAGE_USE_SSE2
+#endif
 
 #include "./api.h"
+#include "./trace.h"
+#include "./utils/alloc_tracker.h"
 
 using namespace std;
 
 namespace cq::message {
+    static const string *atom_names() {
+        // function-local, so that atoms can be used safely during static initialization
+        static const string names[Atom::ID_COUNT] = {
+            "",
+            // in the order of the ids
+            "anonymous", "at", "audio", "bface", "contact", "content", "dice", "emoji", "face",
+            "file", "id", "image", "lat", "location", "lon", "magic", "music", "qq", "record",
+            "rich", "rps", "sface", "shake", "share", "sign", "style", "text", "title", "type",
+            "url",
+        };
+        return names;
+    }
+
+    Atom::Atom(const string &name) {
+        static const auto ids = [] {
+            unordered_map<string_view, Id> ids;
+            for (auto i = 1; i < ID_COUNT; i++) {
+                ids.emplace(atom_names()[i], static_cast<Id>(i));
+            }
+            return ids;
+        }();
+
+        if (const auto it = ids.find(name); it != ids.end()) {
+            id_ = it->second;
+        } else {
+            name_ = name;
+        }
+    }
+
+    const string &Atom::str() const noexcept { return id_ == UNKNOWN ? name_ : atom_names()[id_]; }
+
+    /**
+     * Count the characters that need escaping, 16 bytes at a time where SSE2 is available.
+     */
+    static size_t count_special_chars(const string &str, const bool escape_comma) {
+        const auto data = str.data();
+        const auto size = str.size();
+        size_t count = 0, i = 0;
+
+#ifdef CQ_MESSAGE_USE_SSE2
+        const auto amp = _mm_set1_epi8('&'), lbracket = _mm_set1_epi8('['), rbracket = _mm_set1_epi8(']'),
+                   comma = _mm_set1_epi8(escape_comma ? ',' : '&');
+        for (; i + 16 <= size; i += 16) {
+            const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            const auto hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, amp), _mm_cmpeq_epi8(chunk, lbracket)),
+                                           _mm_or_si128(_mm_cmpeq_epi8(chunk, rbracket), _mm_cmpeq_epi8(chunk, comma)));
+            for (auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits)); mask; mask &= mask - 1) {
+                count++;
+            }
+        }
+#endif
+
+        for (; i < size; i++) {
+            const auto c = data[i];
+            if (c == '&' || c == '[' || c == ']' || (escape_comma && c == ',')) {
+                count++;
+            }
+        }
+        return count;
+    }
+
     string escape(string str, const bool escape_comma) {
-        boost::replace_all(str, "&", "&amp;");
-        boost::replace_all(str, "[", "&#91;");
-        boost::replace_all(str, "]", "&#93;");
-        if (escape_comma) boost::replace_all(str, ",", "&#44;");
+        const auto count = count_special_chars(str, escape_comma);
+        if (count == 0) {
+            return str; // the common case, no copy at all
+        }
+
+        // every escaped form is 5 chars long, so we can grow the string once and fill it from the back
+        const auto old_size = str.size();
+        str.resize(old_size + count * 4);
+        auto out = str.size();
+        for (auto i = old_size; i-- > 0;) {
+            const char *replacement;
+            switch (str[i]) {
+            case '&':
+                replacement = "&amp;";
+                break;
+            case '[':
+                replacement = "&#91;";
+                break;
+            case ']':
+                replacement = "&#93;";
+                break;
+            case ',':
+                replacement = escape_comma ? "&#44;" : nullptr;
+                break;
+            default:
+                replacement = nullptr;
+                break;
+            }
+            if (replacement) {
+                out -= 5;
+                memcpy(&str[out], replacement, 5);
+            } else {
+                str[--out] = str[i];
+            }
+        }
         return str;
     }
 
     string unescape(string str) {
-        boost::replace_all(str, "&#44;", ",");
-        boost::replace_all(str, "&#91;", "[");
-        boost::replace_all(str, "&#93;", "]");
-        boost::replace_all(str, "&amp;", "&");
+        auto amp = str.find('&'); // memchr, which is vectorized by the CRT
+        if (amp == string::npos) {
+            return str;
+        }
+
+        // the unescaped string is never longer, so unescape in place, in a single pass
+        auto out = amp;
+        for (auto i = amp; i < str.size();) {
+            if (str[i] == '&' && i + 5 <= str.size()) {
+                const auto entity = string_view(str).substr(i, 5);
+                char c = 0;
+                if (entity == "&#44;") {
+                    c = ',';
+                } else if (entity == "&#91;") {
+                    c = '[';
+                } else if (entity == "&#93;") {
+                    c = ']';
+                } else if (entity == "&amp;") {
+                    c = '&';
+                }
+                if (c) {
+                    str[out++] = c;
+                    i += 5;
+                    continue;
+                }
+            }
+            str[out++] = str[i++];
+        }
+        str.resize(out);
         return str;
     }
 
     Message::Message(const string &msg_str) {
+        CQ_ALLOC_SCOPE(MESSAGE_PARSE);
+        CQ_TRACE_SPAN(PARSE, "Message");
+
         // implement a DFA manually, because the regex lib of VC++ will throw stack overflow in some cases
 
         const static auto TEXT = 0;
@@ -75,7 +204,7 @@ namespace cq::message {
                     // CQ code end
                     MessageSegment seg;
 
-                    seg.type = function_name_s.str();
+                    seg.type = Atom(function_name_s.str());
 
                     vector<string> params;
                     boost::split(params, params_s.str(), boost::is_any_of(","));
@@ -88,7 +217,7 @@ namespace cq::message {
 
                     if (!text_s.str().empty()) {
                         // there is a text segment before this CQ code
-                        this->push_back(MessageSegment{"text", {{"text", unescape(text_s.str())}}});
+                        this->push_back(MessageSegment::text(unescape(text_s.str())));
                         text_s = stringstream();
                     }
 
@@ -116,7 +245,7 @@ namespace cq::message {
             // should fall through
         case TEXT:
             if (!text_s.str().empty()) {
-                this->push_back(MessageSegment{"text", {{"text", unescape(text_s.str())}}});
+                this->push_back(MessageSegment::text(unescape(text_s.str())));
             }
         default:
             break;
@@ -129,8 +258,8 @@ namespace cq::message {
             if (seg.type.empty()) {
                 continue;
             }
-            if (seg.type == "text") {
-                if (const auto it = seg.data.find("text"); it != seg.data.end()) {
+            if (seg.type == Atom::TEXT) {
+                if (const auto it = seg.data.find(Atom::TEXT); it != seg.data.end()) {
                     ss << escape((*it).second, false);
                 }
             } else {
@@ -149,8 +278,8 @@ namespace cq::message {
     string Message::extract_plain_text() const {
         string result;
         for (const auto &seg : *this) {
-            if (seg.type == "text") {
-                result += seg.data.at("text") + " ";
+            if (seg.type == Atom::TEXT) {
+                result += seg.data.at(Atom::TEXT) + " ";
             }
         }
         if (!result.empty()) {
@@ -159,6 +288,139 @@ namespace cq::message {
         return result;
     }
 
+    static bool is_text_segment(const MessageSegment &seg) {
+        return seg.type == Atom::TEXT && seg.data.find(Atom::TEXT) != seg.data.end();
+    }
+
+    Message &Message::append(const MessageSegment &seg) { return this->append(MessageSegment(seg)); }
+
+    Message &Message::append(MessageSegment &&seg) {
+        if (is_text_segment(seg)) {
+            auto &text = seg.data[Atom::TEXT];
+            if (text.empty()) {
+                return *this; // an empty text segment changes nothing
+            }
+            if (!this->empty() && is_text_segment(this->back())) {
+                this->back().data[Atom::TEXT] += text;
+                return *this;
+            }
+        }
+        this->push_back(std::move(seg));
+        return *this;
+    }
+
+    MessageBuilder &MessageBuilder::append(const MessageSegment &seg) {
+        if (is_text_segment(seg)) {
+            text_ += seg.data.at(Atom::TEXT);
+        } else {
+            flush_text();
+            msg_.push_back(seg);
+        }
+        return *this;
+    }
+
+    Message MessageBuilder::build() {
+        flush_text();
+        auto result = std::move(msg_);
+        msg_.clear();
+        return result;
+    }
+
+    void MessageBuilder::flush_text() {
+        if (!text_.empty()) {
+            msg_.append(MessageSegment{Atom::TEXT, {{Atom::TEXT, std::move(text_)}}});
+            text_.clear();
+        }
+    }
+
+    static thread_local SendCoalescer *current_coalescer = nullptr;
+
+    static bool same_chat(const Target &a, const Target &b) {
+        if (a.group_id.has_value() || b.group_id.has_value()) {
+            return a.group_id == b.group_id;
+        }
+        if (a.discuss_id.has_value() || b.discuss_id.has_value()) {
+            return a.discuss_id == b.discuss_id;
+        }
+        return a.user_id == b.user_id;
+    }
+
+    SendCoalescer::SendCoalescer(const size_t max_size, const string &separator)
+        : max_size_(max_size), separator_(escape(separator, false)), previous_(current_coalescer) {
+        current_coalescer = this;
+    }
+
+    SendCoalescer::~SendCoalescer() {
+        try {
+            flush();
+        } catch (...) {
+            // nothing may escape a destructor
+        }
+        current_coalescer = previous_;
+    }
+
+    SendCoalescer *SendCoalescer::current() noexcept { return current_coalescer; }
+
+    bool SendCoalescer::buffer(const Target &target, const string &msg) {
+        if (flushing_) {
+            return false;
+        }
+
+        auto it = find_if(pending_.begin(), pending_.end(), [&](const Pending &p) { return same_chat(p.target, target); });
+        if (it != pending_.end() && it->message.size() + separator_.size() + msg.size() > max_size_) {
+            // this one doesn't fit, send what we have for this target first
+            flushing_ = true;
+            try {
+                send(*it);
+            } catch (...) {
+                flushing_ = false;
+                throw;
+            }
+            flushing_ = false;
+        }
+        if (it == pending_.end()) {
+            pending_.push_back({target, string(), 0});
+            it = pending_.end() - 1;
+        }
+
+        // join the raw strings, so that what was sent isn't changed by parsing and serializing it again
+        if (it->count > 0) {
+            it->message += separator_;
+        }
+        it->message += msg;
+        it->count++;
+        return true;
+    }
+
+    size_t SendCoalescer::flush() {
+        size_t saved = 0;
+        flushing_ = true;
+        try {
+            for (auto &pending : pending_) {
+                saved += send(pending);
+            }
+        } catch (...) {
+            flushing_ = false;
+            throw;
+        }
+        flushing_ = false;
+        pending_.clear();
+        return saved;
+    }
+
+    size_t SendCoalescer::send(Pending &pending) {
+        if (pending.count == 0) {
+            return 0;
+        }
+        const auto saved = pending.count - 1;
+        const auto msg = std::move(pending.message);
+        pending.message.clear();
+        pending.count = 0;
+        saved_ += saved;
+        api::send_msg(pending.target, msg);
+        return saved;
+    }
+
     void Message::reduce() {
         if (this->empty()) {
             return;
@@ -166,10 +428,9 @@ namespace cq::message {
 
         auto last_seg_it = this->begin();
         for (auto it = this->begin(); ++it != this->end();) {
-            if (it->type == "text" && last_seg_it->type == "text" && it->data.find("text") != it->data.end()
-                && last_seg_it->data.find("text") != last_seg_it->data.end()) {
+            if (is_text_segment(*it) && is_text_segment(*last_seg_it)) {
                 // found adjacent "text" segments
-                last_seg_it->data["text"] += it->data["text"];
+                last_seg_it->data[Atom::TEXT] += it->data[Atom::TEXT];
                 // remove the current element and continue
                 this->erase(it);
                 it = last_seg_it;
@@ -178,7 +439,7 @@ namespace cq::message {
             }
         }
 
-        if (this->size() == 1 && this->front().type == "text" && this->extract_plain_text().empty()) {
+        if (this->size() == 1 && this->front().type == Atom::TEXT && this->extract_plain_text().empty()) {
             this->clear(); // the only item is an empty text segment, we should remove it
         }
     }
@@ -16,41 +16,150 @@ namespace cq::message {
      */
     std::string unescape(std::string str);
 
+    /**
+     * A segment type or a data key.
+     *
+     * Known names are interned as small integers, so comparing them is an integer comparison,
+     * and only unknown names keep their string form.
+     * It still reads like a std::string: it converts to one, compares with and concatenates to strings,
+     * and has c_str(), size(), substr() and find().
+     */
+    class Atom {
+    public:
+        enum Id : uint8_t {
+            UNKNOWN = 0,
+
+            // segment types and data keys, in the order of their names, so that ids sort like names
+            ANONYMOUS, AT, AUDIO, BFACE, CONTACT, CONTENT, DICE, EMOJI, FACE, FILE, ID, IMAGE, LAT,
+            LOCATION, LON, MAGIC, MUSIC, QQ, RECORD, RICH, RPS, SFACE, SHAKE, SHARE, SIGN, STYLE,
+            TEXT, TITLE, TYPE, URL,
+
+            ID_COUNT,
+        };
+
+        Atom() = default;
+        Atom(const Id id) : id_(id) {}
+        Atom(const std::string &name);
+        Atom(const char *name) : Atom(std::string(name)) {}
+
+        Id id() const noexcept { return id_; }
+        bool is_known() const noexcept { return id_ != UNKNOWN; }
+        bool empty() const noexcept { return id_ == UNKNOWN && name_.empty(); }
+
+        const std::string &str() const noexcept;
+        operator const std::string &() const noexcept { return str(); }
+
+        // string-like accessors, for code written when segment types and data keys were std::string
+        const char *c_str() const noexcept { return str().c_str(); }
+        const char *data() const noexcept { return str().data(); }
+        size_t size() const noexcept { return str().size(); }
+        size_t length() const noexcept { return str().length(); }
+        std::string substr(const size_t pos = 0, const size_t count = std::string::npos) const {
+            return str().substr(pos, count);
+        }
+        size_t find(const std::string &s, const size_t pos = 0) const noexcept { return str().find(s, pos); }
+
+        friend bool operator==(const Atom &lhs, const Atom &rhs) {
+            return lhs.id_ == rhs.id_ && (lhs.id_ != UNKNOWN || lhs.name_ == rhs.name_);
+        }
+
+        friend bool operator!=(const Atom &lhs, const Atom &rhs) { return !(lhs == rhs); }
+
+        // comparing with a string compares the names, without interning the string first
+        friend bool operator==(const Atom &lhs, const char *rhs) { return lhs.str() == rhs; }
+        friend bool operator==(const char *lhs, const Atom &rhs) { return rhs == lhs; }
+        friend bool operator==(const Atom &lhs, const std::string &rhs) { return lhs.str() == rhs; }
+        friend bool operator==(const std::string &lhs, const Atom &rhs) { return rhs == lhs; }
+        friend bool operator!=(const Atom &lhs, const char *rhs) { return !(lhs == rhs); }
+        friend bool operator!=(const char *lhs, const Atom &rhs) { return !(rhs == lhs); }
+        friend bool operator!=(const Atom &lhs, const std::string &rhs) { return !(lhs == rhs); }
+        friend bool operator!=(const std::string &lhs, const Atom &rhs) { return !(rhs == lhs); }
+
+        friend std::string operator+(const Atom &lhs, const std::string &rhs) { return lhs.str() + rhs; }
+        friend std::string operator+(const std::string &lhs, const Atom &rhs) { return lhs + rhs.str(); }
+        friend std::string operator+(const Atom &lhs, const char *rhs) { return lhs.str() + rhs; }
+        friend std::string operator+(const char *lhs, const Atom &rhs) { return lhs + rhs.str(); }
+
+        /**
+         * Atoms are ordered by name, like the std::string keys they replace, so data is still serialized in
+         * the same order. Two known atoms compare their ids, which are assigned in the order of the names.
+         */
+        friend bool operator<(const Atom &lhs, const Atom &rhs) {
+            if (lhs.id_ != UNKNOWN && rhs.id_ != UNKNOWN) {
+                return lhs.id_ < rhs.id_;
+            }
+            return lhs.str() < rhs.str();
+        }
+
+        friend std::ostream &operator<<(std::ostream &os, const Atom &atom) { return os << atom.str(); }
+
+    private:
+        Id id_ = UNKNOWN;
+        std::string name_; // only for unknown names
+    };
+
+    /**
+     * The data of a message segment. It converts to and from std::map<std::string, std::string>,
+     * for code written when the keys were plain strings.
+     */
+    struct SegmentData : std::map<Atom, std::string> {
+        using map::map;
+
+        SegmentData() = default;
+
+        SegmentData(const std::map<std::string, std::string> &data) {
+            for (const auto &[key, value] : data) {
+                this->emplace(key, value);
+            }
+        }
+
+        operator std::map<std::string, std::string>() const {
+            std::map<std::string, std::string> result;
+            for (const auto &[key, value] : *this) {
+                result.emplace_hint(result.end(), key.str(), value);
+            }
+            return result;
+        }
+    };
+
     struct MessageSegment {
-        std::string type;
-        std::map<std::string, std::string> data;
+        Atom type;
+        SegmentData data;
 
-        static MessageSegment text(const std::string &text) { return {"text", {{"text", text}}}; }
-        static MessageSegment emoji(const uint32_t id) { return {"emoji", {{"id", std::to_string(id)}}}; }
-        static MessageSegment face(const int id) { return {"face", {{"id", std::to_string(id)}}}; }
-        static MessageSegment image(const std::string &file) { return {"image", {{"file", file}}}; }
+        static MessageSegment text(const std::string &text) { return {Atom::TEXT, {{Atom::TEXT, text}}}; }
+        static MessageSegment emoji(const uint32_t id) { return {Atom::EMOJI, {{Atom::ID, std::to_string(id)}}}; }
+        static MessageSegment face(const int id) { return {Atom::FACE, {{Atom::ID, std::to_string(id)}}}; }
+        static MessageSegment image(const std::string &file) { return {Atom::IMAGE, {{Atom::FILE, file}}}; }
 
         static MessageSegment record(const std::string &file, const bool magic = false) {
-            return {"record", {{"file", file}, {"magic", std::to_string(magic)}}};
+            return {Atom::RECORD, {{Atom::FILE, file}, {Atom::MAGIC, std::to_string(magic)}}};
         }
 
-        static MessageSegment at(const int64_t user_id) { return {"at", {{"qq", std::to_string(user_id)}}}; }
-        static MessageSegment rps() { return {"rps", {}}; }
-        static MessageSegment dice() { return {"dice", {}}; }
-        static MessageSegment shake() { return {"shake", {}}; }
+        static MessageSegment at(const int64_t user_id) { return {Atom::AT, {{Atom::QQ, std::to_string(user_id)}}}; }
+        static MessageSegment rps() { return {Atom::RPS, {}}; }
+        static MessageSegment dice() { return {Atom::DICE, {}}; }
+        static MessageSegment shake() { return {Atom::SHAKE, {}}; }
 
         static MessageSegment anonymous(const bool ignore_failure = false) {
-            return {"anonymous", {{"ignore", std::to_string(ignore_failure)}}};
+            return {Atom::ANONYMOUS, {{"ignore", std::to_string(ignore_failure)}}};
         }
 
         static MessageSegment share(const std::string &url, const std::string &title, const std::string &content = "",
                                     const std::string &image_url = "") {
-            return {"share", {{"url", url}, {"title", title}, {"content", content}, {"image", image_url}}};
+            return {
+                Atom::SHARE,
+                {{Atom::URL, url}, {Atom::TITLE, title}, {Atom::CONTENT, content}, {Atom::IMAGE, image_url}},
+            };
         }
 
         enum class ContactType { USER, GROUP };
 
         static MessageSegment contact(const ContactType &type, const int64_t id) {
             return {
-                "contact",
+                Atom::CONTACT,
                 {
-                    {"type", type == ContactType::USER ? "qq" : "group"},
-                    {"id", std::to_string(id)},
+                    {Atom::TYPE, type == ContactType::USER ? "qq" : "group"},
+                    {Atom::ID, std::to_string(id)},
                 },
             };
         }
@@ -58,38 +167,46 @@ namespace cq::message {
         static MessageSegment location(const double latitude, const double longitude, const std::string &title = "",
                                        const std::string &content = "") {
             return {
-                "location",
+                Atom::LOCATION,
                 {
-                    {"lat", std::to_string(latitude)},
-                    {"lon", std::to_string(longitude)},
-                    {"title", title},
-                    {"content", content},
+                    {Atom::LAT, std::to_string(latitude)},
+                    {Atom::LON, std::to_string(longitude)},
+                    {Atom::TITLE, title},
+                    {Atom::CONTENT, content},
                 },
             };
         }
 
         static MessageSegment music(const std::string &type, const int64_t id) {
-            return {"music", {{"type", type}, {"id", std::to_string(id)}}};
+            return {Atom::MUSIC, {{Atom::TYPE, type}, {Atom::ID, std::to_string(id)}}};
         }
 
         static MessageSegment music(const std::string &type, const int64_t id, const int32_t style) {
-            return {"music", {{"type", type}, {"id", std::to_string(id)}, {"style", std::to_string(style)}}};
+            return {
+                Atom::MUSIC,
+                {{Atom::TYPE, type}, {Atom::ID, std::to_string(id)}, {Atom::STYLE, std::to_string(style)}},
+            };
         }
 
         static MessageSegment music(const std::string &url, const std::string &audio_url, const std::string &title,
                                     const std::string &content = "", const std::string &image_url = "") {
             return {
-                "music",
+                Atom::MUSIC,
                 {
-                    {"type", "custom"},
-                    {"url", url},
-                    {"audio", audio_url},
-                    {"title", title},
-                    {"content", content},
-                    {"image", image_url},
+                    {Atom::TYPE, "custom"},
+                    {Atom::URL, url},
+                    {Atom::AUDIO, audio_url},
+                    {Atom::TITLE, title},
+                    {Atom::CONTENT, content},
+                    {Atom::IMAGE, image_url},
                 },
             };
         }
+
+        /**
+         * Copy the data with plain string keys, for code that still expects std::map<std::string, std::string>.
+         */
+        std::map<std::string, std::string> string_data() const { return data; }
     };
 
     struct Message : std::list<MessageSegment> {
@@ -110,8 +227,9 @@ namespace cq::message {
         operator std::string() const;
 
         Message &operator+=(const Message &other) {
-            this->insert(this->end(), other.begin(), other.end());
-            this->reduce();
+            for (const auto &seg : other) {
+                this->append(seg);
+            }
             return *this;
         }
 
@@ -144,12 +262,116 @@ namespace cq::message {
         std::list<MessageSegment> &segments() { return *this; }
         const std::list<MessageSegment> &segments() const { return *this; }
 
+        /**
+         * Append a segment, merging it into the last one if both are "text" segments.
+         * Unlike reduce(), this only looks at the last segment, so building a message this way is linear.
+         */
+        Message &append(const MessageSegment &seg);
+        Message &append(MessageSegment &&seg);
+
         /**
          * Merge adjacent "text" segments.
          */
         void reduce();
     };
 
+    /**
+     * Build a message segment by segment, collecting adjacent text in a single buffer.
+     */
+    class MessageBuilder {
+    public:
+        /**
+         * Reserve space for the text that will be appended before the next non-text segment.
+         */
+        MessageBuilder &reserve(const size_t text_size) {
+            text_.reserve(text_size);
+            return *this;
+        }
+
+        MessageBuilder &append_text(const std::string &text) {
+            text_ += text;
+            return *this;
+        }
+
+        MessageBuilder &append(const MessageSegment &seg);
+
+        MessageBuilder &append(const Message &msg) {
+            for (const auto &seg : msg) {
+                append(seg);
+            }
+            return *this;
+        }
+
+        template <typename T>
+        MessageBuilder &operator<<(const T &other) {
+            return append(other);
+        }
+
+        /**
+         * Get the built message. The builder is left empty.
+         */
+        Message build();
+
+    private:
+        Message msg_;
+        std::string text_;
+
+        void flush_text();
+    };
+
+    /**
+     * Coalesce messages sent with api::send_msg on the current thread, during the lifetime of this object.
+     *
+     * Messages to the same target are joined by "separator", which is plain text and escaped, without
+     * touching the messages themselves, up to "max_size" bytes per call, and sent when the coalescer
+     * is flushed or destroyed. Errors while sending from the destructor are ignored.
+     * api::send_msg returns 0 for the messages buffered this way, since they don't have an id yet.
+     */
+    class SendCoalescer {
+    public:
+        explicit SendCoalescer(size_t max_size = 4000, const std::string &separator = "\n");
+        ~SendCoalescer();
+
+        SendCoalescer(const SendCoalescer &) = delete;
+        SendCoalescer &operator=(const SendCoalescer &) = delete;
+
+        /**
+         * Buffer a message if this coalescer is active. This is internally called by api::send_msg.
+         */
+        bool buffer(const Target &target, const std::string &msg);
+
+        /**
+         * Send all buffered messages, and return the number of sends saved by coalescing.
+         */
+        size_t flush() noexcept(false);
+
+        /**
+         * The total number of sends saved so far.
+         */
+        size_t saved() const noexcept { return saved_; }
+
+        /**
+         * Get the innermost coalescer of the current thread, or nullptr if none.
+         */
+        static SendCoalescer *current() noexcept;
+
+    private:
+        struct Pending {
+            Target target;
+            std::string message;
+            size_t count = 0;
+        };
+
+        size_t max_size_;
+        std::string separator_; // escaped
+        SendCoalescer *previous_;
+        std::vector<Pending> pending_; // in the order of the first message to each target
+        size_t saved_ = 0;
+        bool flushing_ = false;
+
+        size_t send(Pending &pending);
+    };
+
     template <typename T>
     Message operator+(const T &lhs, const Message &rhs) {
         return Message(lhs) + rhs;
@@ -0,0 +1,103 @@
+#include "./message_cache.h"
+
+#include "./api.h"
+
+using namespace std;
+
+namespace cq {
+    MessageCache message_cache;
+
+    void MessageCache::record_incoming(const event::MessageEvent &e) {
+        if (!options.enabled) {
+            return;
+        }
+        Entry entry;
+        entry.message_id = e.message_id;
+        entry.target = e.target;
+        entry.raw_message = e.raw_message;
+        put(std::move(entry));
+    }
+
+    void MessageCache::record_outgoing(const Target &target, const int64_t message_id, const string &msg) {
+        if (!options.enabled) {
+            return;
+        }
+        Entry entry;
+        entry.message_id = message_id;
+        entry.target = target;
+        entry.raw_message = msg;
+        entry.outgoing = true;
+        put(std::move(entry));
+
+        lock_guard<mutex> lock(last_sent_mutex_);
+        last_sent_[target.chat_key()] = message_id;
+    }
+
+    optional<MessageCache::Entry> MessageCache::find(const int64_t message_id) const {
+        const auto &shard = shards_[static_cast<uint64_t>(message_id) % SHARD_COUNT];
+        lock_guard<mutex> lock(shard.mutex);
+        if (const auto it = shard.slot_of.find(message_id); it != shard.slot_of.end()) {
+            return shard.ring[it->second];
+        }
+        return nullopt;
+    }
+
+    optional<MessageCache::Entry> MessageCache::last_sent(const Target &target) const {
+        int64_t message_id;
+        {
+            lock_guard<mutex> lock(last_sent_mutex_);
+            const auto it = last_sent_.find(target.chat_key());
+            if (it == last_sent_.end()) {
+                return nullopt;
+            }
+            message_id = it->second;
+        }
+        return find(message_id);
+    }
+
+    bool MessageCache::recall_last_sent(const Target &target) {
+        const auto entry = last_sent(target);
+        if (!entry) {
+            return false;
+        }
+        api::delete_msg(entry->message_id);
+
+        lock_guard<mutex> lock(last_sent_mutex_);
+        if (const auto it = last_sent_.find(target.chat_key());
+            it != last_sent_.end() && it->second == entry->message_id) {
+            last_sent_.erase(it);
+        }
+        return true;
+    }
+
+    void MessageCache::reset() {
+        for (auto &shard : shards_) {
+            lock_guard<mutex> lock(shard.mutex);
+            shard.ring.clear();
+            shard.ring.shrink_to_fit();
+            shard.slot_of.clear();
+            shard.next = 0;
+        }
+        lock_guard<mutex> lock(last_sent_mutex_);
+        last_sent_.clear();
+    }
+
+    void MessageCache::put(Entry &&entry) {
+        auto &shard = shards_[static_cast<uint64_t>(entry.message_id) % SHARD_COUNT];
+        lock_guard<mutex> lock(shard.mutex);
+        if (shard.ring.empty()) {
+            shard.ring.resize(max(options.capacity / SHARD_COUNT, size_t(1)));
+            shard.slot_of.reserve(shard.ring.size());
+        }
+
+        const auto slot = shard.next;
+        shard.next = (shard.next + 1) % shard.ring.size();
+
+        auto &old = shard.ring[slot];
+        if (const auto it = shard.slot_of.find(old.message_id); it != shard.slot_of.end() && it->second == slot) {
+            shard.slot_of.erase(it);
+        }
+        shard.slot_of[entry.message_id] = slot;
+        old = std::move(entry);
+    }
+} // namespace cq
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "./common.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#include "./event.h"
+#include "./target.h"
+
+namespace cq {
+    /**
+     * A bounded cache of recent incoming and outgoing messages, keyed by message id.
+     *
+     * Messages are kept in a fixed number of sharded rings, and the oldest ones are overwritten
+     * when a ring is full, so lookups by id are O(1) and the memory usage is bounded.
+     */
+    class MessageCache {
+    public:
+        struct Options {
+            bool enabled = false;
+            size_t capacity = 8192; // total number of messages kept, across all shards
+        };
+
+        struct Entry {
+            int64_t message_id = 0;
+            Target target; // the chat, plus the sender in "user_id" for incoming messages
+            std::string raw_message;
+            bool outgoing = false;
+        };
+
+        Options options;
+
+        /**
+         * Remember an incoming message. This is internally called by the event layer.
+         */
+        void record_incoming(const event::MessageEvent &e);
+
+        /**
+         * Remember a message sent by us. This is internally called by api::send_msg.
+         */
+        void record_outgoing(const Target &target, int64_t message_id, const std::string &msg);
+
+        std::optional<Entry> find(int64_t message_id) const;
+
+        /**
+         * Find the last message we sent to the chat of the given target.
+         */
+        std::optional<Entry> last_sent(const Target &target) const;
+
+        /**
+         * Recall the last message we sent to the chat of the given target.
+         * Return false if there isn't one in the cache.
+         */
+        bool recall_last_sent(const Target &target) noexcept(false);
+
+        /**
+         * Drop all messages, and apply the current capacity.
+         */
+        void reset();
+
+        static const size_t SHARD_COUNT = 16;
+
+    private:
+        struct Shard {
+            mutable std::mutex mutex;
+            std::vector<Entry> ring;
+            size_t next = 0;
+            std::unordered_map<int64_t, size_t> slot_of;
+        };
+
+        Shard shards_[SHARD_COUNT];
+
+        mutable std::mutex last_sent_mutex_;
+        std::unordered_map<uint64_t, int64_t> last_sent_; // chat key -> message id
+
+        void put(Entry &&entry);
+    };
+
+    extern MessageCache message_cache;
+} // namespace cq
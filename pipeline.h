@@ -0,0 +1,469 @@
+#pragma once
+
+#include "./common.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include "./utils/bounded_queue.h"
+
+/**
+ * Staged event processing, as an alternative to doing everything in the event handler.
+ *
+ * A pipeline is a chain of typed stages, each with its own threads and a bounded lock-free queue in front:
+ *
+ *     auto commands = pipeline::from<event::GroupMessageEvent>()
+ *         .filter("commands", [](const auto &e) { return boost::starts_with(e.raw_message, "/"); })
+ *         .map("enrich", [](event::GroupMessageEvent e) { return Command{...}; }, {1024, Backpressure::BLOCK, 4})
+ *         .sink("act", [](Command c) { ... });
+ *     commands.start();
+ *
+ * A started pipeline is fed by the event layer with every event of exactly its input type, before the
+ * regular handler (e.g. event::on_group_msg) runs. Events are copied into the pipeline, so e.block() has no effect there.
+ * Stages only accept items while started, a push into a stopped pipeline is dropped.
+ * A stage with parallelism 1 keeps the order of items, while a stage with more threads (for stateless work)
+ * does not. Idle stage threads back off up to 1 ms, which bounds the latency added by each stage.
+ */
+namespace cq::pipeline {
+    enum class Backpressure {
+        BLOCK, // wait for room in the queue
+        DROP_OLDEST, // make room by dropping the oldest queued item
+        DROP_NEW, // drop the item being pushed
+    };
+
+    struct StageOptions {
+        size_t capacity = 1024;
+        Backpressure backpressure = Backpressure::BLOCK;
+        size_t parallelism = 1; // threads running this stage
+    };
+
+    struct StageMetrics {
+        std::string name;
+        uint64_t received = 0; // items accepted into the queue
+        uint64_t dropped = 0; // items dropped by backpressure
+        uint64_t processed = 0;
+        uint64_t emitted = 0; // items passed to the next stage
+        size_t queued = 0;
+        double throughput = 0; // processed items per second since start
+    };
+
+    /**
+     * Wait a bit longer each time while there is nothing to do.
+     */
+    class Backoff {
+    public:
+        void wait() {
+            if (count_ < 64) {
+                count_++;
+            } else if (count_ < 128) {
+                count_++;
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(sleep_);
+                sleep_ = std::min(sleep_ * 2, std::chrono::microseconds(1000));
+            }
+        }
+
+        void reset() {
+            count_ = 0;
+            sleep_ = std::chrono::microseconds(50);
+        }
+
+    private:
+        int count_ = 0;
+        std::chrono::microseconds sleep_{50};
+    };
+
+    template <typename T>
+    class Inlet {
+    public:
+        virtual ~Inlet() = default;
+        virtual bool push(T &&item) = 0;
+    };
+
+    template <typename T>
+    class Outlet {
+    public:
+        virtual ~Outlet() = default;
+        virtual void connect(Inlet<T> *next) = 0;
+    };
+
+    /**
+     * The pipelines fed with events of type E by the event layer.
+     */
+    template <typename E>
+    class Source {
+    public:
+        static void attach(const std::shared_ptr<Inlet<E>> &inlet) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto inlets = inlets_ ? std::make_shared<Inlets>(*inlets_) : std::make_shared<Inlets>();
+            inlets->push_back(inlet);
+            std::atomic_store(&inlets_, std::shared_ptr<const Inlets>(std::move(inlets)));
+            count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static void detach(const Inlet<E> *inlet) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!inlets_) {
+                return;
+            }
+            auto inlets = std::make_shared<Inlets>();
+            for (const auto &item : *inlets_) {
+                const auto p = item.lock();
+                if (p && p.get() != inlet) {
+                    inlets->push_back(item);
+                }
+            }
+            count_.store(inlets->size(), std::memory_order_relaxed);
+            std::atomic_store(&inlets_, std::shared_ptr<const Inlets>(std::move(inlets)));
+        }
+
+        /**
+         * Push a copy of the event into each attached pipeline.
+         * This is internally called by the event layer, and costs a relaxed load if there is none.
+         */
+        static void __feed(const E &e) {
+            if (count_.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+            const auto inlets = std::atomic_load(&inlets_);
+            if (!inlets) {
+                return;
+            }
+            for (const auto &item : *inlets) {
+                if (const auto inlet = item.lock()) {
+                    inlet->push(E(e));
+                }
+            }
+        }
+
+    private:
+        using Inlets = std::vector<std::weak_ptr<Inlet<E>>>;
+
+        inline static std::mutex mutex_;
+        inline static std::shared_ptr<const Inlets> inlets_; // copied on write, so feeding never locks
+        inline static std::atomic<size_t> count_{0};
+    };
+
+    class StageBase {
+    public:
+        virtual ~StageBase() = default;
+        virtual void start() = 0;
+        virtual void close_and_join() = 0;
+        virtual StageMetrics metrics() const = 0;
+    };
+
+    /**
+     * The output type of a sink.
+     */
+    struct Nothing {};
+
+    /**
+     * A stage taking In, and passing whatever the process function returns (if not nullopt) to the next stage.
+     */
+    template <typename In, typename Out>
+    class Stage final : public StageBase, public Inlet<In>, public Outlet<Out> {
+    public:
+        using Process = std::function<std::optional<Out>(In &&)>;
+
+        Stage(std::string name, const StageOptions &options, Process process, const bool multi_producer)
+            : name_(std::move(name)), options_(options), process_(std::move(process)) {
+            // the SPSC queue can't be used if the producer has to pop for DROP_OLDEST
+            if (multi_producer || options_.parallelism > 1 || options_.backpressure == Backpressure::DROP_OLDEST) {
+                mpmc_ = std::make_unique<utils::MpmcQueue<In>>(options_.capacity);
+            } else {
+                spsc_ = std::make_unique<utils::SpscQueue<In>>(options_.capacity);
+            }
+        }
+
+        ~Stage() { close_and_join(); }
+
+        void connect(Inlet<Out> *next) override { next_ = next; }
+
+        /**
+         * Queue an item, or return false if it's dropped, which is also the case while the stage is not started.
+         */
+        bool push(In &&item) override {
+            if (closed_.load(std::memory_order_relaxed)) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (try_push(item)) {
+                received_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            switch (options_.backpressure) {
+            case Backpressure::BLOCK: {
+                Backoff backoff;
+                while (!try_push(item)) {
+                    if (closed_.load(std::memory_order_relaxed)) {
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    backoff.wait();
+                }
+                break;
+            }
+            case Backpressure::DROP_OLDEST: {
+                In oldest;
+                while (!try_push(item)) {
+                    if (closed_.load(std::memory_order_relaxed)) {
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    if (mpmc_->try_pop(oldest)) {
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                break;
+            }
+            case Backpressure::DROP_NEW:
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            received_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        void start() override {
+            if (!threads_.empty()) {
+                return;
+            }
+            closed_.store(false, std::memory_order_relaxed);
+            start_time_ = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < std::max(options_.parallelism, size_t(1)); i++) {
+                threads_.emplace_back([this] { run(); });
+            }
+        }
+
+        /**
+         * Stop accepting items, and wait for the queued ones to be processed.
+         */
+        void close_and_join() override {
+            closed_.store(true, std::memory_order_relaxed);
+            for (auto &t : threads_) {
+                if (t.joinable()) {
+                    t.join();
+                }
+            }
+            threads_.clear();
+        }
+
+        StageMetrics metrics() const override {
+            StageMetrics m;
+            m.name = name_;
+            m.received = received_.load(std::memory_order_relaxed);
+            m.dropped = dropped_.load(std::memory_order_relaxed);
+            m.processed = processed_.load(std::memory_order_relaxed);
+            m.emitted = emitted_.load(std::memory_order_relaxed);
+            m.queued = mpmc_ ? mpmc_->size() : spsc_->size();
+            const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+            m.throughput = seconds > 0 ? static_cast<double>(m.processed) / seconds : 0;
+            return m;
+        }
+
+    private:
+        std::string name_;
+        StageOptions options_;
+        Process process_;
+        Inlet<Out> *next_ = nullptr;
+        std::unique_ptr<utils::MpmcQueue<In>> mpmc_;
+        std::unique_ptr<utils::SpscQueue<In>> spsc_;
+        std::vector<std::thread> threads_;
+        std::atomic<bool> closed_{true}; // until started
+        std::chrono::steady_clock::time_point start_time_;
+
+        std::atomic<uint64_t> received_{0};
+        std::atomic<uint64_t> dropped_{0};
+        std::atomic<uint64_t> processed_{0};
+        std::atomic<uint64_t> emitted_{0};
+
+        bool try_push(In &item) { return mpmc_ ? mpmc_->try_push(item) : spsc_->try_push(item); }
+        bool try_pop(In &item) { return mpmc_ ? mpmc_->try_pop(item) : spsc_->try_pop(item); }
+
+        void run() {
+            Backoff backoff;
+            In item;
+            while (true) {
+                if (!try_pop(item)) {
+                    if (closed_.load(std::memory_order_relaxed) && !try_pop(item)) {
+                        return; // closed and drained
+                    }
+                    backoff.wait();
+                    continue;
+                }
+                backoff.reset();
+
+                std::optional<Out> result;
+                try {
+                    result = process_(std::move(item));
+                } catch (...) {
+                    // a failed item must not stop the stage
+                }
+                processed_.fetch_add(1, std::memory_order_relaxed);
+                if (result && next_ && next_->push(std::move(*result))) {
+                    emitted_.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+    };
+
+    /**
+     * A built pipeline, taking In at the first stage.
+     */
+    template <typename In>
+    class Pipeline {
+    public:
+        Pipeline(Pipeline &&) = default;
+        Pipeline &operator=(Pipeline &&) = default;
+
+        ~Pipeline() { stop(); }
+
+        /**
+         * Start the stages, and unless feed_events is false, have the event layer feed the pipeline
+         * with every event of type In.
+         */
+        void start(const bool feed_events = true) {
+            for (const auto &stage : stages_) {
+                stage->start();
+            }
+            if (feed_events && first_ && !attached_) {
+                Source<In>::attach(first_);
+                attached_ = true;
+            }
+        }
+
+        /**
+         * Stop feeding the pipeline, and stop the stages in order, after each has processed what is queued.
+         */
+        void stop() {
+            if (attached_ && first_) {
+                Source<In>::detach(first_.get());
+            }
+            attached_ = false;
+            for (const auto &stage : stages_) {
+                stage->close_and_join();
+            }
+        }
+
+        /**
+         * Push an item into the first stage, and return false if it's dropped.
+         */
+        bool push(In item) { return first_ && first_->push(std::move(item)); }
+
+        /**
+         * Get an event handler feeding this pipeline, for a pipeline started with feed_events = false,
+         * e.g. to only pass some events on from your own handler. The handler does nothing once the pipeline is gone.
+         */
+        std::function<void(const In &)> handler() const {
+            std::weak_ptr<Inlet<In>> first = first_;
+            return [first](const In &e) {
+                if (const auto inlet = first.lock()) {
+                    inlet->push(In(e));
+                }
+            };
+        }
+
+        std::vector<StageMetrics> metrics() const {
+            std::vector<StageMetrics> result;
+            for (const auto &stage : stages_) {
+                result.push_back(stage->metrics());
+            }
+            return result;
+        }
+
+    private:
+        template <typename, typename>
+        friend class Builder;
+
+        Pipeline() = default;
+
+        std::vector<std::shared_ptr<StageBase>> stages_;
+        std::shared_ptr<Inlet<In>> first_; // shared with Source<In> and handler(), which only keep weak pointers
+        bool attached_ = false;
+    };
+
+    template <typename In, typename Cur>
+    class Builder {
+    public:
+        Builder() : pipeline_(new Pipeline<In>()) {}
+
+        /**
+         * Transform each item. The function takes Cur (by value or const reference) and returns the new item.
+         */
+        template <typename F, typename Out = std::decay_t<std::invoke_result_t<F, Cur &&>>>
+        Builder<In, Out> map(std::string name, F f, const StageOptions &options = {}) && {
+            return add<Out>(std::move(name), options, [f = std::move(f)](Cur &&item) -> std::optional<Out> {
+                return f(std::move(item));
+            });
+        }
+
+        /**
+         * Only pass the items that the predicate returns true for.
+         */
+        template <typename F>
+        Builder<In, Cur> filter(std::string name, F predicate, const StageOptions &options = {}) && {
+            return add<Cur>(std::move(name), options, [predicate = std::move(predicate)](Cur &&item) -> std::optional<Cur> {
+                if (!predicate(static_cast<const Cur &>(item))) {
+                    return std::nullopt;
+                }
+                return std::move(item);
+            });
+        }
+
+        /**
+         * Consume each item, and finish the pipeline.
+         */
+        template <typename F>
+        Pipeline<In> sink(std::string name, F f, const StageOptions &options = {}) && {
+            auto builder = std::move(*this).template add<Nothing>(
+                std::move(name), options, [f = std::move(f)](Cur &&item) -> std::optional<Nothing> {
+                    f(std::move(item));
+                    return std::nullopt;
+                });
+            return std::move(*builder.pipeline_);
+        }
+
+    private:
+        template <typename, typename>
+        friend class Builder;
+
+        std::unique_ptr<Pipeline<In>> pipeline_;
+        Outlet<Cur> *last_ = nullptr;
+        size_t last_parallelism_ = 0; // 0 for the event source, which may push from any thread
+
+        template <typename Out>
+        Builder<In, Out> add(std::string name, const StageOptions &options,
+                             std::function<std::optional<Out>(Cur &&)> process) {
+            auto stage = std::make_shared<Stage<Cur, Out>>(
+                std::move(name), options, std::move(process), last_parallelism_ != 1);
+            if (last_) {
+                last_->connect(stage.get());
+            } else {
+                if constexpr (std::is_same_v<Cur, In>) {
+                    pipeline_->first_ = stage;
+                }
+            }
+
+            Builder<In, Out> next(std::move(pipeline_), stage.get(), std::max(options.parallelism, size_t(1)));
+            next.pipeline_->stages_.push_back(std::move(stage));
+            return next;
+        }
+
+        Builder(std::unique_ptr<Pipeline<In>> pipeline, Outlet<Cur> *last, const size_t last_parallelism)
+            : pipeline_(std::move(pipeline)), last_(last), last_parallelism_(last_parallelism) {}
+    };
+
+    /**
+     * Start building a pipeline taking In, usually an event type.
+     */
+    template <typename In>
+    Builder<In, In> from() {
+        return Builder<In, In>();
+    }
+} // namespace cq::pipeline
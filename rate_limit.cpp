@@ -0,0 +1,160 @@
+#include "./rate_limit.h"
+
+#include "./utils/hash.h"
+
+using namespace std;
+
+namespace cq {
+    RateLimiter rate_limiter;
+
+    static int64_t now_ms() {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static uint64_t fingerprint_of(const Target &target, const string_view key) {
+        const auto seed = utils::mix64(target.chat_key() ^ utils::mix64(static_cast<uint64_t>(target.user_id.value_or(0))));
+        const auto fingerprint = utils::xxhash64(key.data(), key.size(), seed);
+        return fingerprint ? fingerprint : 1;
+    }
+
+    static size_t round_up_pow2(const size_t n) {
+        size_t size = 8;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    RateLimiter::RateLimiter(const size_t initial_shard_size)
+        : initial_shard_size_(round_up_pow2(initial_shard_size)) {}
+
+    RateLimiter::Slot *RateLimiter::find(Shard &shard, const uint64_t fingerprint, const int64_t now,
+                                         const bool insert) {
+        if (shard.slots.empty()) {
+            if (!insert) {
+                return nullptr;
+            }
+            shard.slots.resize(initial_shard_size_);
+        }
+
+        const auto mask = shard.slots.size() - 1;
+        Slot *reusable = nullptr;
+        // the low bits pick the shard, so probe with the high ones
+        for (auto i = (fingerprint >> 32) & mask;; i = (i + 1) & mask) {
+            auto &slot = shard.slots[i];
+            if (slot.fingerprint == fingerprint) {
+                return &slot;
+            }
+            if (slot.fingerprint == 0) {
+                break;
+            }
+            if (!reusable && slot.full_at <= now) {
+                reusable = &slot;
+            }
+        }
+        if (!insert) {
+            return nullptr;
+        }
+
+        if (!reusable) {
+            if ((shard.used + 1) * 4 > shard.slots.size() * 3) {
+                rehash(shard, now);
+                return find(shard, fingerprint, now, true);
+            }
+            shard.used++;
+            for (auto i = (fingerprint >> 32) & mask;; i = (i + 1) & mask) {
+                if (shard.slots[i].fingerprint == 0) {
+                    reusable = &shard.slots[i];
+                    break;
+                }
+            }
+        }
+        reusable->fingerprint = fingerprint;
+        reusable->full_at = now;
+        return reusable;
+    }
+
+    void RateLimiter::rehash(Shard &shard, const int64_t now) {
+        size_t live = 0;
+        for (const auto &slot : shard.slots) {
+            live += slot.fingerprint && slot.full_at > now;
+        }
+
+        // drop the expired slots, and only grow if the live ones take more than half of the table
+        auto size = shard.slots.size();
+        while (live * 2 >= size) {
+            size <<= 1;
+        }
+        vector<Slot> old(size);
+        old.swap(shard.slots);
+        shard.used = 0;
+
+        const auto mask = size - 1;
+        for (const auto &slot : old) {
+            if (slot.fingerprint == 0 || slot.full_at <= now) {
+                continue;
+            }
+            auto i = (slot.fingerprint >> 32) & mask;
+            while (shard.slots[i].fingerprint) {
+                i = (i + 1) & mask;
+            }
+            shard.slots[i] = slot;
+            shard.used++;
+        }
+    }
+
+    bool RateLimiter::try_acquire(const Target &target, const string_view key, const uint32_t burst,
+                                  const chrono::milliseconds period) {
+        const auto fingerprint = fingerprint_of(target, key);
+        const auto now = now_ms();
+        const auto period_ms = period.count();
+        auto &shard = shards_[fingerprint % SHARD_COUNT];
+
+        lock_guard<mutex> lock(shard.mutex);
+        const auto slot = find(shard, fingerprint, now, true);
+        const auto full_at = max(slot->full_at, now);
+        // each taken token pushes the full time one period further, and the bucket is empty
+        // when that is more than (burst - 1) periods away
+        if (full_at - now > (static_cast<int64_t>(burst) - 1) * period_ms) {
+            return false;
+        }
+        slot->full_at = full_at + period_ms;
+        return true;
+    }
+
+    chrono::milliseconds RateLimiter::retry_after(const Target &target, const string_view key, const uint32_t burst,
+                                                  const chrono::milliseconds period) {
+        const auto fingerprint = fingerprint_of(target, key);
+        const auto now = now_ms();
+        auto &shard = shards_[fingerprint % SHARD_COUNT];
+
+        lock_guard<mutex> lock(shard.mutex);
+        const auto slot = find(shard, fingerprint, now, false);
+        if (!slot) {
+            return chrono::milliseconds(0);
+        }
+        const auto wait = slot->full_at - now - (static_cast<int64_t>(burst) - 1) * period.count();
+        return chrono::milliseconds(max(wait, int64_t(0)));
+    }
+
+    size_t RateLimiter::size() {
+        const auto now = now_ms();
+        size_t count = 0;
+        for (auto &shard : shards_) {
+            lock_guard<mutex> lock(shard.mutex);
+            for (const auto &slot : shard.slots) {
+                count += slot.fingerprint && slot.full_at > now;
+            }
+        }
+        return count;
+    }
+
+    void RateLimiter::reset() {
+        for (auto &shard : shards_) {
+            lock_guard<mutex> lock(shard.mutex);
+            shard.slots.clear();
+            shard.slots.shrink_to_fit();
+            shard.used = 0;
+        }
+    }
+} // namespace cq
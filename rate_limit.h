@@ -0,0 +1,71 @@
+#pragma once
+
+#include "./common.h"
+
+#include <chrono>
+#include <mutex>
+
+#include "./target.h"
+
+namespace cq {
+    /**
+     * Cooldowns and rate limits keyed by (Target, key), e.g. "user X may use command Y once per N seconds".
+     *
+     * Each (Target, key) pair is a token bucket, stored as a 16-byte slot (a fingerprint and the time
+     * the bucket becomes full again) in open-addressing tables split into independently locked shards.
+     * A bucket that has become full again is the same as no bucket at all, so such slots are reused
+     * lazily, and the memory usage follows the number of users actually being limited.
+     */
+    class RateLimiter {
+    public:
+        explicit RateLimiter(size_t initial_shard_size = 64);
+
+        /**
+         * Take a token from the bucket of (target, key), which holds at most "burst" tokens,
+         * and gets one back every "period". Return false if the bucket is empty.
+         */
+        bool try_acquire(const Target &target, std::string_view key, uint32_t burst, std::chrono::milliseconds period);
+
+        /**
+         * Allow once per "period".
+         */
+        bool cooldown(const Target &target, const std::string_view key, const std::chrono::milliseconds period) {
+            return try_acquire(target, key, 1, period);
+        }
+
+        /**
+         * Get how long to wait before try_acquire() with the same arguments would succeed, without taking a token.
+         */
+        std::chrono::milliseconds retry_after(const Target &target, std::string_view key, uint32_t burst,
+                                              std::chrono::milliseconds period);
+
+        /**
+         * The number of buckets not yet full, i.e. the users currently being limited.
+         */
+        size_t size();
+
+        void reset();
+
+        static const size_t SHARD_COUNT = 64;
+
+    private:
+        struct Slot {
+            uint64_t fingerprint = 0; // 0 for never used slots
+            int64_t full_at = 0; // milliseconds, the bucket is full (and the slot reusable) after this time
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            std::vector<Slot> slots;
+            size_t used = 0; // slots with a fingerprint, expired or not
+        };
+
+        Shard shards_[SHARD_COUNT];
+        size_t initial_shard_size_;
+
+        Slot *find(Shard &shard, uint64_t fingerprint, int64_t now, bool insert);
+        void rehash(Shard &shard, int64_t now);
+    };
+
+    extern RateLimiter rate_limiter;
+} // namespace cq
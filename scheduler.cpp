@@ -0,0 +1,255 @@
+#include "./scheduler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "./utils/thread_pool.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace cq::scheduler {
+    Options options;
+
+    // 4 levels, the first with 256 slots of 1 tick, and the others with 64 slots each,
+    // which covers 2^26 ticks (about 7.7 days at 10 ms), longer timers are cascaded again when due
+    static const int ROOT_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const int LEVEL_COUNT = 3;
+    static const uint64_t ROOT_SIZE = 1 << ROOT_BITS;
+    static const uint64_t LEVEL_SIZE = 1 << LEVEL_BITS;
+    static const uint64_t MAX_SPAN = uint64_t(1) << (ROOT_BITS + LEVEL_COUNT * LEVEL_BITS);
+
+    struct Task {
+        function<void()> run;
+        atomic<bool> in_flight{false}; // posted to the workers and not finished yet
+    };
+
+    struct Timer {
+        TaskId id;
+        uint64_t expires; // in ticks
+        uint64_t interval; // in ticks, 0 for one-shot tasks
+        shared_ptr<Task> task;
+        Timer *prev = nullptr;
+        Timer *next = nullptr;
+        Timer **slot = nullptr; // the list head this timer is in
+    };
+
+    static mutex wheel_mutex;
+    static condition_variable wheel_cv;
+    static Timer *root_slots[ROOT_SIZE];
+    static Timer *level_slots[LEVEL_COUNT][LEVEL_SIZE];
+    static unordered_map<TaskId, unique_ptr<Timer>> timers;
+    static TaskId next_id = 1;
+    static uint64_t current_tick = 0;
+
+    static thread timer_thread;
+    static unique_ptr<utils::ThreadPool> workers;
+    static bool running = false;
+
+    static void link(Timer *timer, Timer **slot) {
+        timer->slot = slot;
+        timer->prev = nullptr;
+        timer->next = *slot;
+        if (*slot) {
+            (*slot)->prev = timer;
+        }
+        *slot = timer;
+    }
+
+    static void unlink(Timer *timer) {
+        if (timer->prev) {
+            timer->prev->next = timer->next;
+        } else {
+            *timer->slot = timer->next;
+        }
+        if (timer->next) {
+            timer->next->prev = timer->prev;
+        }
+        timer->slot = nullptr;
+        timer->prev = timer->next = nullptr;
+    }
+
+    static void place(Timer *timer) {
+        if (timer->expires <= current_tick) {
+            link(timer, &root_slots[current_tick & (ROOT_SIZE - 1)]); // already due, run on this tick
+            return;
+        }
+        const auto delta = timer->expires - current_tick;
+        if (delta < ROOT_SIZE) {
+            link(timer, &root_slots[timer->expires & (ROOT_SIZE - 1)]);
+            return;
+        }
+        // too far away timers are parked in the last level, and placed again when cascaded
+        const auto expires = delta < MAX_SPAN ? timer->expires : current_tick + MAX_SPAN - 1;
+        for (auto level = 0; level < LEVEL_COUNT; level++) {
+            const auto shift = ROOT_BITS + (level + 1) * LEVEL_BITS;
+            if (delta < (uint64_t(1) << shift) || level == LEVEL_COUNT - 1) {
+                const auto index = (expires >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+                link(timer, &level_slots[level][index]);
+                return;
+            }
+        }
+    }
+
+    static size_t cascade(const int level) {
+        const auto index = (current_tick >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+        auto timer = level_slots[level][index];
+        level_slots[level][index] = nullptr;
+        while (timer) {
+            const auto next = timer->next;
+            timer->slot = nullptr;
+            place(timer);
+            timer = next;
+        }
+        return index;
+    }
+
+    static uint64_t ticks_of(const chrono::milliseconds duration) {
+        return max(static_cast<uint64_t>((duration + TICK - chrono::milliseconds(1)) / TICK), uint64_t(1));
+    }
+
+    static TaskId add(const chrono::milliseconds delay, const uint64_t interval, function<void()> task) {
+        TaskId id;
+        {
+            lock_guard<mutex> lock(wheel_mutex);
+            if (!running) {
+                return 0; // nothing would run it, and __stop() cancels all tasks anyway
+            }
+            id = next_id++;
+            auto timer = make_unique<Timer>();
+            timer->id = id;
+            timer->expires = current_tick + ticks_of(delay);
+            timer->interval = interval;
+            timer->task = make_shared<Task>();
+            timer->task->run = std::move(task);
+            place(timer.get());
+            timers.emplace(id, std::move(timer));
+        }
+        wheel_cv.notify_one();
+        return id;
+    }
+
+    TaskId run_after(const chrono::milliseconds delay, function<void()> task) { return add(delay, 0, std::move(task)); }
+
+    TaskId run_every(const chrono::milliseconds interval, function<void()> task) {
+        return add(interval, ticks_of(interval), std::move(task));
+    }
+
+    bool cancel(const TaskId id) {
+        lock_guard<mutex> lock(wheel_mutex);
+        const auto it = timers.find(id);
+        if (it == timers.end()) {
+            return false;
+        }
+        unlink(it->second.get());
+        timers.erase(it);
+        return true;
+    }
+
+    size_t pending_count() {
+        lock_guard<mutex> lock(wheel_mutex);
+        return timers.size();
+    }
+
+    /**
+     * Advance the wheel by one tick, and collect the due tasks.
+     */
+    static void tick(vector<shared_ptr<Task>> &due) {
+        const auto index = current_tick & (ROOT_SIZE - 1);
+        if (index == 0) {
+            for (auto level = 0; level < LEVEL_COUNT && cascade(level) == 0; level++) {
+            }
+        }
+
+        auto timer = root_slots[index];
+        root_slots[index] = nullptr;
+        while (timer) {
+            const auto next = timer->next;
+            timer->slot = nullptr;
+            if (!timer->task->in_flight.exchange(true)) {
+                due.push_back(timer->task);
+            } // else a periodic task still running its previous round, skip this one
+            if (timer->interval > 0) {
+                timer->expires += timer->interval;
+                current_tick++; // so that a periodic task due again right now goes to the next round
+                place(timer);
+                current_tick--;
+            } else {
+                timers.erase(timer->id);
+            }
+            timer = next;
+        }
+        current_tick++;
+    }
+
+    static void run_timer() {
+        auto start = Clock::now();
+        const auto start_tick = current_tick;
+        vector<shared_ptr<Task>> due;
+
+        unique_lock<mutex> lock(wheel_mutex);
+        while (running) {
+            if (timers.empty()) {
+                wheel_cv.wait(lock);
+                // nothing was pending, so the wheel just continues from where it is
+                start = Clock::now() - (current_tick - start_tick) * TICK;
+                continue;
+            }
+
+            const auto target_tick = start_tick + static_cast<uint64_t>((Clock::now() - start) / TICK);
+            while (current_tick <= target_tick) {
+                tick(due);
+            }
+
+            if (!due.empty()) {
+                lock.unlock();
+                for (const auto &task : due) {
+                    workers->post([task] {
+                        struct Finish {
+                            Task &task;
+                            ~Finish() { task.in_flight.store(false); }
+                        } finish{*task};
+                        task->run();
+                    });
+                }
+                due.clear();
+                lock.lock();
+            }
+
+            wheel_cv.wait_until(lock, start + (current_tick - start_tick) * TICK);
+        }
+    }
+
+    void __start() {
+        lock_guard<mutex> lock(wheel_mutex);
+        if (running) {
+            return;
+        }
+        running = true;
+        workers = make_unique<utils::ThreadPool>(options.worker_count);
+        timer_thread = thread(run_timer);
+    }
+
+    void __stop() {
+        {
+            lock_guard<mutex> lock(wheel_mutex);
+            if (!running) {
+                return;
+            }
+            running = false;
+            for (auto &item : timers) {
+                unlink(item.second.get());
+            }
+            timers.clear();
+        }
+        wheel_cv.notify_all();
+        timer_thread.join();
+        workers->stop();
+        workers.reset();
+    }
+} // namespace cq::scheduler
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "./common.h"
+
+#include <chrono>
+
+/**
+ * A scheduler for one-shot and periodic tasks, driven by a hierarchical timer wheel.
+ *
+ * A single timer thread advances the wheel every TICK, and hands due tasks off to a small worker pool.
+ * Scheduling and cancelling are O(1), so hundreds of thousands of pending timers (e.g. cooldowns) are fine.
+ * The scheduler runs while the app is enabled; disabling the app or exiting CoolQ cancels all tasks.
+ */
+namespace cq::scheduler {
+    using TaskId = uint64_t;
+
+    constexpr auto TICK = std::chrono::milliseconds(10);
+
+    struct Options {
+        size_t worker_count = 2;
+    };
+
+    extern Options options;
+
+    /**
+     * Run a task once after the given delay, on one of the workers.
+     * Tasks can only be added while the scheduler is running: before the app is enabled
+     * and after it is disabled, nothing is scheduled and 0 is returned.
+     */
+    TaskId run_after(std::chrono::milliseconds delay, std::function<void()> task);
+
+    /**
+     * Run a task every "interval", the first time after "interval" as well, or return 0 like run_after().
+     * If a run takes longer than the interval, the rounds due in the meantime are skipped,
+     * so runs of the same task never overlap.
+     */
+    TaskId run_every(std::chrono::milliseconds interval, std::function<void()> task);
+
+    /**
+     * Cancel a pending task. Return false if it has already run (for one-shot tasks) or been cancelled.
+     * A periodic task that is running at the moment finishes its current run.
+     */
+    bool cancel(TaskId id);
+
+    size_t pending_count();
+
+    /**
+     * Start or stop the timer thread and the workers.
+     * These are internally called when the app is enabled, disabled, or CoolQ is exiting.
+     */
+    void __start();
+    void __stop();
+} // namespace cq::scheduler
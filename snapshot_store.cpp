@@ -0,0 +1,192 @@
+#include "./snapshot_store.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+#include "./api.h"
+#include "./dir.h"
+#include "./logging.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace cq {
+    static const char MAGIC[4] = {'C', 'Q', 'S', 'S'};
+    static const int32_t VERSION = 1;
+    static const size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(int32_t) + sizeof(int64_t);
+
+    static const string GROUP_LIST = "groups";
+
+    static string group_member_list_name(const int64_t group_id) { return "members_" + to_string(group_id); }
+
+    template <typename IntType>
+    static void push_int(string &bytes, const IntType value) {
+        // big endian, as what BinPack::pop_int expects
+        for (auto i = static_cast<int>(sizeof(IntType)) - 1; i >= 0; i--) {
+            bytes.push_back(static_cast<char>((static_cast<uint64_t>(value) >> (i * 8)) & 0xFF));
+        }
+    }
+
+    /**
+     * The saved bytes of an opened snapshot, after the header.
+     */
+    static string_view payload_of(const utils::MappedFile &file) {
+        return {file.data() + HEADER_SIZE, file.size() - HEADER_SIZE};
+    }
+
+    optional<vector<Group>> SnapshotStore::load_group_list() const {
+        if (const auto file = open(GROUP_LIST)) {
+            try {
+                return ObjectHelper::multi_from_bytes<vector<Group>>(payload_of(*file));
+            } catch (exception::ParseError &) {
+            }
+        }
+        return nullopt;
+    }
+
+    optional<vector<GroupMember>> SnapshotStore::load_group_member_list(const int64_t group_id) const {
+        if (const auto file = open(group_member_list_name(group_id))) {
+            try {
+                return ObjectHelper::multi_from_bytes<vector<GroupMember>>(payload_of(*file));
+            } catch (exception::ParseError &) {
+            }
+        }
+        return nullopt;
+    }
+
+    int64_t SnapshotStore::saved_time_of_group_list() const {
+        int64_t saved_time = 0;
+        open(GROUP_LIST, &saved_time);
+        return saved_time;
+    }
+
+    int64_t SnapshotStore::saved_time_of_group_member_list(const int64_t group_id) const {
+        int64_t saved_time = 0;
+        open(group_member_list_name(group_id), &saved_time);
+        return saved_time;
+    }
+
+    vector<Group> SnapshotStore::fetch_group_list() {
+        const auto bytes = utils::base64::decode(api::get_group_list_base64());
+        vector<Group> result;
+        try {
+            result = ObjectHelper::multi_from_bytes<vector<Group>>(bytes);
+        } catch (exception::ParseError &) {
+            throw exception::ApiError(exception::ApiError::INVALID_DATA);
+        }
+        write(GROUP_LIST, bytes);
+        return result;
+    }
+
+    vector<GroupMember> SnapshotStore::fetch_group_member_list(const int64_t group_id) {
+        const auto bytes = utils::base64::decode(api::get_group_member_list_base64(group_id));
+        vector<GroupMember> result;
+        try {
+            result = ObjectHelper::multi_from_bytes<vector<GroupMember>>(bytes);
+        } catch (exception::ParseError &) {
+            throw exception::ApiError(exception::ApiError::INVALID_DATA);
+        }
+        write(group_member_list_name(group_id), bytes);
+        return result;
+    }
+
+    vector<Group> SnapshotStore::group_list() {
+        if (auto groups = load_group_list()) {
+            return std::move(*groups);
+        }
+        return fetch_group_list();
+    }
+
+    vector<GroupMember> SnapshotStore::group_member_list(const int64_t group_id) {
+        if (auto members = load_group_member_list(group_id)) {
+            return std::move(*members);
+        }
+        return fetch_group_member_list(group_id);
+    }
+
+    future<void> SnapshotStore::revalidate_async(
+        function<void(const Group &, const vector<GroupMember> &)> on_updated) const {
+        return async(launch::async, [store = *this, on_updated = std::move(on_updated)]() mutable {
+            vector<Group> groups;
+            try {
+                groups = store.fetch_group_list();
+            } catch (std::exception &e) {
+                logging::warning("SnapshotStore", string("failed to revalidate the group list: ") + e.what());
+                return;
+            } catch (...) {
+                logging::warning("SnapshotStore", "failed to revalidate the group list");
+                return;
+            }
+            for (const auto &group : groups) {
+                try {
+                    const auto members = store.fetch_group_member_list(group.group_id);
+                    if (on_updated) {
+                        on_updated(group, members);
+                    }
+                } catch (std::exception &e) {
+                    logging::warning("SnapshotStore",
+                                     "failed to revalidate group " + to_string(group.group_id) + ": " + e.what());
+                } catch (...) {
+                    logging::warning("SnapshotStore", "failed to revalidate group " + to_string(group.group_id));
+                }
+            }
+        });
+    }
+
+    string SnapshotStore::path_of(const string &name) const {
+        return dir::app_per_account(sub_dir_name_) + name + ".bin";
+    }
+
+    optional<utils::MappedFile> SnapshotStore::open(const string &name, int64_t *saved_time) const {
+        utils::MappedFile file;
+        try {
+            file = utils::MappedFile(path_of(name));
+        } catch (exception::RuntimeError &) {
+            return nullopt;
+        }
+        if (file.size() < HEADER_SIZE || memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0) {
+            return nullopt;
+        }
+
+        auto header = utils::BinPack::view({file.data() + sizeof(MAGIC), HEADER_SIZE - sizeof(MAGIC)});
+        if (header.pop_int<int32_t>() != VERSION) {
+            return nullopt;
+        }
+        const auto time = header.pop_int<int64_t>();
+        if (saved_time) {
+            *saved_time = time;
+        }
+        return file;
+    }
+
+    bool SnapshotStore::write(const string &name, const string &bytes) const {
+        string content(MAGIC, sizeof(MAGIC));
+        content.reserve(HEADER_SIZE + bytes.size());
+        push_int(content, VERSION);
+        push_int(content,
+                 static_cast<int64_t>(
+                     chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count()));
+        content += bytes;
+
+        // write to a temporary file first, so that a crash never leaves a half-written snapshot
+        const auto path = utils::ansi(path_of(name));
+        const auto tmp_path = path + ".tmp";
+        {
+            ofstream out(tmp_path, ios::binary | ios::trunc);
+            out.write(content.data(), content.size());
+            if (!out) {
+                logging::warning("SnapshotStore", "failed to write snapshot " + name);
+                return false;
+            }
+        }
+        error_code ec;
+        fs::rename(tmp_path, path, ec);
+        if (ec) {
+            logging::warning("SnapshotStore", "failed to replace snapshot " + name + ": " + ec.message());
+            fs::remove(tmp_path, ec);
+            return false;
+        }
+        return true;
+    }
+} // namespace cq
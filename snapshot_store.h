@@ -0,0 +1,70 @@
+#pragma once
+
+#include "./common.h"
+
+#include <future>
+
+#include "./types.h"
+#include "./utils/mmap.h"
+
+namespace cq {
+    /**
+     * Persistent snapshots of the group list and group member lists, under dir::app_per_account.
+     *
+     * Snapshots are saved as the exact bytes CoolQ returns (a big-endian count followed by
+     * length-prefixed objects, which BinPack understands), behind a small header, so that
+     * loading one is a file mapping plus parsing in place, with no API call or base64 decoding.
+     * Strings are still converted from GB18030 as they are parsed.
+     */
+    class SnapshotStore {
+    public:
+        explicit SnapshotStore(const std::string &sub_dir_name = "snapshot") : sub_dir_name_(sub_dir_name) {}
+
+        /**
+         * Load the saved group list. Return nullopt if there isn't a valid one.
+         */
+        std::optional<std::vector<Group>> load_group_list() const;
+
+        /**
+         * Load the saved member list of a group. Return nullopt if there isn't a valid one.
+         */
+        std::optional<std::vector<GroupMember>> load_group_member_list(int64_t group_id) const;
+
+        /**
+         * Get the time (in seconds since epoch) when the snapshot was saved, or 0 if there isn't one.
+         */
+        int64_t saved_time_of_group_list() const;
+        int64_t saved_time_of_group_member_list(int64_t group_id) const;
+
+        /**
+         * Fetch the group list from CoolQ and save it.
+         */
+        std::vector<Group> fetch_group_list() noexcept(false);
+
+        /**
+         * Fetch the member list of a group from CoolQ and save it.
+         */
+        std::vector<GroupMember> fetch_group_member_list(int64_t group_id) noexcept(false);
+
+        /**
+         * Load the group list and member lists from disk if possible, otherwise fetch them from CoolQ.
+         */
+        std::vector<Group> group_list() noexcept(false);
+        std::vector<GroupMember> group_member_list(int64_t group_id) noexcept(false);
+
+        /**
+         * Refetch the group list and all member lists in the background.
+         * "on_updated" is called in the background thread after each group's member list is saved.
+         * Failed groups are skipped, and failures are logged as warnings.
+         */
+        std::future<void> revalidate_async(
+            std::function<void(const Group &, const std::vector<GroupMember> &)> on_updated = nullptr) const;
+
+    private:
+        std::string sub_dir_name_;
+
+        std::string path_of(const std::string &name) const;
+        std::optional<utils::MappedFile> open(const std::string &name, int64_t *saved_time = nullptr) const;
+        bool write(const std::string &name, const std::string &bytes) const;
+    };
+} // namespace cq
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "./common.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "./scheduler.h"
+#include "./target.h"
+
+namespace cq {
+    /**
+     * A concurrent map from Target to plugin state, e.g. per-group settings or per-user scores.
+     *
+     * The map is split into shards, each with its own reader-writer lock. Values are immutable snapshots
+     * (std::shared_ptr<const V>): readers only hold the shared lock to copy the pointer, and writers
+     * publish a new snapshot instead of modifying the old one, so a reader can keep using what it got.
+     * The shard lock stays for readers: std::atomic_load of a shared_ptr takes a spinlock anyway,
+     * and lock-free copy-on-write shards make every write copy its shard (BM_AtomicSnapshotShardsReadMostly).
+     *
+     * The key is the whole Target, so use e.g. Target::group(group_id) for per-group state,
+     * rather than the target of a message event, which also has the user id.
+     *
+     * With a TTL, entries expire after not being written for that long. Expired entries are invisible
+     * right away, and removed by a sweeper task on the scheduler.
+     */
+    template <typename V>
+    class StateStore {
+    public:
+        struct Options {
+            size_t shard_count = 64;
+            std::chrono::milliseconds ttl = std::chrono::milliseconds(0); // 0 for never
+        };
+
+        StateStore() : StateStore(Options()) {}
+
+        explicit StateStore(const Options &options) : core_(std::make_shared<Core>(options)) {}
+
+        ~StateStore() {
+            if (const auto task = core_->sweeper_task.load()) {
+                scheduler::cancel(task);
+            }
+        }
+
+        StateStore(const StateStore &) = delete;
+        StateStore &operator=(const StateStore &) = delete;
+
+        /**
+         * Get a snapshot of the value, or nullptr if there is none.
+         */
+        std::shared_ptr<const V> get(const Target &target) const {
+            auto &shard = core_->shard_of(target);
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            const auto it = shard.entries.find(target);
+            if (it == shard.entries.end() || core_->expired(it->second, Core::now())) {
+                return nullptr;
+            }
+            return it->second.value;
+        }
+
+        V get_or(const Target &target, V default_value) const {
+            const auto value = get(target);
+            return value ? *value : std::move(default_value);
+        }
+
+        bool contains(const Target &target) const { return get(target) != nullptr; }
+
+        void set(const Target &target, V value) { publish(target, std::make_shared<const V>(std::move(value))); }
+
+        /**
+         * Modify a copy of the current value (or a default constructed one), and publish it as the new value.
+         * The function runs under the exclusive lock of the shard, so keep it short.
+         */
+        template <typename F>
+        std::shared_ptr<const V> update(const Target &target, F f) {
+            auto &shard = core_->shard_of(target);
+            const auto now = Core::now();
+            std::shared_ptr<const V> result;
+            {
+                std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                const auto it = shard.entries.find(target);
+                const auto current = it != shard.entries.end() && !core_->expired(it->second, now) ? it->second.value
+                                                                                                  : nullptr;
+                auto value = current ? std::make_shared<V>(*current) : std::make_shared<V>();
+                f(*value); // if this throws, the store is left untouched
+                auto &entry = it != shard.entries.end() ? it->second : shard.entries[target];
+                entry.value = std::move(value);
+                entry.expires_at = core_->expires_at(now);
+                result = entry.value;
+            }
+            ensure_sweeper(now);
+            return result;
+        }
+
+        bool erase(const Target &target) {
+            auto &shard = core_->shard_of(target);
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            return shard.entries.erase(target) > 0;
+        }
+
+        /**
+         * The number of entries, including expired ones not swept yet.
+         */
+        size_t size() const {
+            size_t count = 0;
+            for (auto &shard : core_->shards) {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                count += shard.entries.size();
+            }
+            return count;
+        }
+
+        void clear() {
+            for (auto &shard : core_->shards) {
+                std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                shard.entries.clear();
+            }
+        }
+
+        /**
+         * Call f(const Target &, const V &) for each entry not expired, one shard at a time.
+         */
+        template <typename F>
+        void for_each(F f) const {
+            const auto now = Core::now();
+            for (auto &shard : core_->shards) {
+                std::vector<std::pair<Target, std::shared_ptr<const V>>> snapshot;
+                {
+                    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                    snapshot.reserve(shard.entries.size());
+                    for (const auto &item : shard.entries) {
+                        if (item.second.value && !core_->expired(item.second, now)) {
+                            snapshot.emplace_back(item.first, item.second.value);
+                        }
+                    }
+                }
+                for (const auto &item : snapshot) {
+                    f(item.first, *item.second);
+                }
+            }
+        }
+
+        /**
+         * Remove the expired entries now, and return how many were removed.
+         */
+        size_t sweep() { return core_->sweep(); }
+
+    private:
+        struct Entry {
+            std::shared_ptr<const V> value;
+            int64_t expires_at = 0; // milliseconds, 0 for never
+        };
+
+        struct Shard {
+            mutable std::shared_mutex mutex;
+            std::unordered_map<Target, Entry> entries;
+        };
+
+        // shared with the sweeper task, which may outlive the store for a moment
+        struct Core {
+            Options options;
+            std::vector<Shard> shards;
+            std::atomic<scheduler::TaskId> sweeper_task{0};
+            std::atomic<int64_t> last_sweep{0};
+
+            explicit Core(const Options &options)
+                : options(options), shards(std::max(options.shard_count, size_t(1))) {}
+
+            static int64_t now() {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+            }
+
+            Shard &shard_of(const Target &target) { return shards[std::hash<Target>()(target) % shards.size()]; }
+
+            int64_t expires_at(const int64_t now) const {
+                return options.ttl.count() > 0 ? now + options.ttl.count() : 0;
+            }
+
+            bool expired(const Entry &entry, const int64_t now) const {
+                return entry.expires_at != 0 && entry.expires_at <= now;
+            }
+
+            size_t sweep() {
+                const auto now = Core::now();
+                last_sweep.store(now, std::memory_order_relaxed);
+                size_t removed = 0;
+                for (auto &shard : shards) {
+                    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                    for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+                        if (expired(it->second, now)) {
+                            it = shard.entries.erase(it);
+                            removed++;
+                        } else {
+                            ++it;
+                        }
+                    }
+                }
+                return removed;
+            }
+        };
+
+        std::shared_ptr<Core> core_;
+
+        void publish(const Target &target, std::shared_ptr<const V> value) {
+            auto &shard = core_->shard_of(target);
+            const auto now = Core::now();
+            {
+                std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                auto &entry = shard.entries[target];
+                entry.value = std::move(value);
+                entry.expires_at = core_->expires_at(now);
+            }
+            ensure_sweeper(now);
+        }
+
+        /**
+         * Schedule the sweeper, if there is a TTL and it hasn't run for a while,
+         * which is also the case when the scheduler was stopped with the app.
+         */
+        void ensure_sweeper(const int64_t now) {
+            const auto ttl = core_->options.ttl;
+            if (ttl.count() <= 0) {
+                return;
+            }
+            auto last = core_->last_sweep.load(std::memory_order_relaxed);
+            if (now - last < 2 * ttl.count()
+                || !core_->last_sweep.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+                return;
+            }
+
+            if (const auto old_task = core_->sweeper_task.exchange(0)) {
+                scheduler::cancel(old_task);
+            }
+            std::weak_ptr<Core> weak_core = core_;
+            core_->sweeper_task.store(scheduler::run_every(ttl, [weak_core] {
+                if (const auto core = weak_core.lock()) {
+                    core->sweep();
+                }
+            }));
+        }
+    };
+} // namespace cq
@@ -2,6 +2,8 @@
 
 #include "./common.h"
 
+#include "./utils/hash.h"
+
 namespace cq {
     struct Target {
         std::optional<int64_t> user_id;
@@ -30,8 +32,38 @@ namespace cq {
             this->user_id = user_id;
         }
 
+        /**
+         * Get a key identifying the chat of this target, i.e. the group, the discuss, or the private chat.
+         * The highest 2 bits hold the chat type, which never collide with a real id.
+         */
+        uint64_t chat_key() const {
+            if (group_id.has_value()) {
+                return (uint64_t(1) << 62) | static_cast<uint64_t>(group_id.value());
+            }
+            if (discuss_id.has_value()) {
+                return (uint64_t(2) << 62) | static_cast<uint64_t>(discuss_id.value());
+            }
+            return static_cast<uint64_t>(user_id.value_or(0));
+        }
+
+        bool operator==(const Target &other) const {
+            return user_id == other.user_id && group_id == other.group_id && discuss_id == other.discuss_id;
+        }
+
+        bool operator!=(const Target &other) const { return !(*this == other); }
+
         static Target user(const int64_t user_id) { return Target(user_id, USER); }
         static Target group(const int64_t group_id) { return Target(group_id, GROUP); }
         static Target discuss(const int64_t discuss_id) { return Target(discuss_id, DISCUSS); }
     };
 } // namespace cq
+
+namespace std {
+    template <>
+    struct hash<cq::Target> {
+        size_t operator()(const cq::Target &target) const noexcept {
+            const auto user_hash = cq::utils::mix64(static_cast<uint64_t>(target.user_id.value_or(0)));
+            return static_cast<size_t>(cq::utils::mix64(target.chat_key() ^ user_hash));
+        }
+    };
+} // namespace std
@@ -0,0 +1,161 @@
+#include "./trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#include "./dir.h"
+#include "./exception.h"
+#include "./utils/string.h"
+
+using namespace std;
+
+namespace cq::trace {
+    Options options;
+    atomic<bool> __enabled{false};
+
+    static const char *const CATEGORY_NAMES[CATEGORY_COUNT] = {"event", "decode", "parse", "handler", "api"};
+
+    struct Record {
+        const char *name;
+        uint64_t event_id;
+        int64_t start; // nanoseconds
+        int64_t duration;
+        Category category;
+    };
+
+    struct ThreadBuffer {
+        mutex mutex_; // only contended while exporting
+        vector<Record> records;
+        size_t next = 0;
+        bool wrapped = false;
+        uint32_t tid = 0;
+    };
+
+    static mutex buffers_mutex;
+    // a buffer only referenced from here belongs to a thread that has exited, and is handed to the next new thread,
+    // so that short-lived threads (e.g. of execute_batch) don't add a buffer each
+    static vector<shared_ptr<ThreadBuffer>> buffers;
+    static uint32_t next_tid = 1;
+    static atomic<uint64_t> next_event_id{1};
+    static thread_local uint64_t current_event_id = 0;
+
+    static ThreadBuffer &thread_buffer() {
+        static thread_local shared_ptr<ThreadBuffer> buffer;
+        if (!buffer) {
+            lock_guard<mutex> lock(buffers_mutex);
+            for (const auto &orphan : buffers) {
+                if (orphan.use_count() == 1) {
+                    buffer = orphan; // the old spans stay, on the same row, until overwritten
+                    return *buffer;
+                }
+            }
+            buffer = make_shared<ThreadBuffer>();
+            buffer->records.resize(max(options.buffer_size, size_t(1)));
+            buffer->tid = next_tid++;
+            buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    void start() { __enabled.store(true, memory_order_relaxed); }
+
+    void stop() { __enabled.store(false, memory_order_relaxed); }
+
+    int64_t __now() noexcept {
+        const auto now =
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+        return now ? now : 1;
+    }
+
+    void __record(const Category category, const char *name, const int64_t start) noexcept {
+        const auto end = __now();
+        try {
+            auto &buffer = thread_buffer();
+            lock_guard<mutex> lock(buffer.mutex_);
+            buffer.records[buffer.next] = {name, current_event_id, start, end - start, category};
+            if (++buffer.next == buffer.records.size()) {
+                buffer.next = 0;
+                buffer.wrapped = true;
+            }
+        } catch (...) {
+            // never let tracing break the traced code
+        }
+    }
+
+    EventSpan::EventSpan(const char *name) noexcept
+        : name_(name), start_(enabled() ? __now() : 0), previous_event_id_(current_event_id) {
+        if (start_) {
+            current_event_id = next_event_id.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    EventSpan::~EventSpan() noexcept {
+        if (start_) {
+            __record(EVENT, name_, start_);
+            current_event_id = previous_event_id_;
+        }
+    }
+
+    void reset() {
+        lock_guard<mutex> lock(buffers_mutex);
+        // free the buffers of exited threads
+        buffers.erase(remove_if(buffers.begin(),
+                                buffers.end(),
+                                [](const shared_ptr<ThreadBuffer> &buffer) { return buffer.use_count() == 1; }),
+                      buffers.end());
+        for (const auto &buffer : buffers) {
+            lock_guard<mutex> buffer_lock(buffer->mutex_);
+            buffer->next = 0;
+            buffer->wrapped = false;
+        }
+    }
+
+    static void append_record(string &json, const Record &record, const uint32_t tid) {
+        char line[320];
+        snprintf(line,
+                 sizeof(line),
+                 R"({"name":"%s","cat":"%s","ph":"X","ts":%.3f,"dur":%.3f,"pid":1,"tid":%u,"args":{"event_id":%llu}})",
+                 record.name,
+                 CATEGORY_NAMES[record.category],
+                 record.start / 1000.0,
+                 record.duration / 1000.0,
+                 tid,
+                 static_cast<unsigned long long>(record.event_id));
+        if (json.back() != '[') {
+            json += ",\n";
+        }
+        json += line;
+    }
+
+    string to_json() {
+        string json = R"({"displayTimeUnit":"ms","traceEvents":[)";
+        lock_guard<mutex> lock(buffers_mutex);
+        for (const auto &buffer : buffers) {
+            lock_guard<mutex> buffer_lock(buffer->mutex_);
+            const auto count = buffer->wrapped ? buffer->records.size() : buffer->next;
+            const auto first = buffer->wrapped ? buffer->next : 0;
+            for (size_t i = 0; i < count; i++) {
+                append_record(json, buffer->records[(first + i) % buffer->records.size()], buffer->tid);
+            }
+        }
+        json += "]}";
+        return json;
+    }
+
+    string dump() {
+        const auto time_ms =
+            chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        const auto path = dir::app("trace") + "trace_" + to_string(time_ms) + ".json";
+        const auto json = to_json();
+
+        ofstream out(utils::ansi(path), ios::binary | ios::trunc);
+        out.write(json.data(), json.size());
+        if (!out) {
+            throw exception::RuntimeError("failed to write the trace file");
+        }
+        return path;
+    }
+} // namespace cq::trace
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "./common.h"
+
+#include <atomic>
+
+/**
+ * Event-to-event latency tracing.
+ *
+ * Once started, every exported event gets an id, and spans of decoding, message parsing, the user handler,
+ * and the API calls made inside are recorded into a ring buffer of the current thread, tagged with that id.
+ * dump() writes the recorded spans as Chrome trace-event JSON, which can be opened in chrome://tracing
+ * or Perfetto. When not started, a span costs one relaxed atomic load.
+ */
+namespace cq::trace {
+    enum Category : uint8_t {
+        EVENT, // the whole exported event function
+        DECODE, // string_from_coolq, and parsing objects returned by the API
+        PARSE, // Message(const std::string &)
+        HANDLER, // user event handlers
+        API, // CoolQ API calls
+        CATEGORY_COUNT,
+    };
+
+    struct Options {
+        size_t buffer_size = 65536; // spans kept per thread, older ones are overwritten
+    };
+
+    extern Options options;
+
+    extern std::atomic<bool> __enabled;
+
+    inline bool enabled() noexcept { return __enabled.load(std::memory_order_relaxed); }
+
+    void start();
+    void stop();
+
+    /**
+     * Forget all recorded spans, and free the buffers of the threads that have exited.
+     */
+    void reset();
+
+    /**
+     * Get the recorded spans as Chrome trace-event JSON.
+     */
+    std::string to_json();
+
+    /**
+     * Write the recorded spans to "trace\trace_<time>.json" under the app directory, and return the path.
+     */
+    std::string dump();
+
+    int64_t __now() noexcept;
+    void __record(Category category, const char *name, int64_t start) noexcept;
+
+    /**
+     * Record the time from construction to destruction, if tracing is enabled at construction.
+     * The name must be a string literal or otherwise live forever.
+     */
+    class Span {
+    public:
+        Span(const Category category, const char *name) noexcept
+            : category_(category), name_(name), start_(enabled() ? __now() : 0) {}
+
+        ~Span() noexcept {
+            if (start_) {
+                __record(category_, name_, start_);
+            }
+        }
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+    private:
+        Category category_;
+        const char *name_;
+        int64_t start_;
+    };
+
+    /**
+     * Like Span, and also give a new event id to the spans recorded on this thread until destruction.
+     */
+    class EventSpan {
+    public:
+        explicit EventSpan(const char *name) noexcept;
+        ~EventSpan() noexcept;
+
+        EventSpan(const EventSpan &) = delete;
+        EventSpan &operator=(const EventSpan &) = delete;
+
+    private:
+        const char *name_;
+        int64_t start_;
+        uint64_t previous_event_id_;
+    };
+} // namespace cq::trace
+
+#define CQ_TRACE_SPAN(category, name) ::cq::trace::Span __cq_trace_span(::cq::trace::category, name)
+#define CQ_TRACE_EVENT(name) ::cq::trace::EventSpan __cq_trace_event(name)
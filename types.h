@@ -3,6 +3,8 @@
 #include "./common.h"
 
 #include "./exception.h"
+#include "./trace.h"
+#include "./utils/alloc_tracker.h"
 #include "./utils/base64.h"
 #include "./utils/binpack.h"
 
@@ -14,28 +16,69 @@ namespace cq {
          */
         template <typename T>
         static T from_base64(const std::string &b64) {
+            CQ_ALLOC_SCOPE(RESULT_DECODE);
+            CQ_TRACE_SPAN(DECODE, "from_base64");
             return T::from_bytes(utils::base64::decode(b64));
         }
 
+        /**
+         * Like from_base64, but return false instead of throwing, in which case "result" is untouched.
+         */
+        template <typename T>
+        static bool try_from_base64(const std::string &b64, T &result) {
+            CQ_ALLOC_SCOPE(RESULT_DECODE);
+            CQ_TRACE_SPAN(DECODE, "from_base64");
+            return T::try_from_bytes(utils::base64::decode(b64), result);
+        }
+
         /**
          * Parse multiple objects from a given base64 string.
          * This is prefered to "T::from_bytes" because it may have extra behaviors.
          */
         template <typename Container>
         static Container multi_from_base64(const std::string &b64) {
+            return multi_from_bytes<Container>(utils::base64::decode(b64));
+        }
+
+        template <typename Container>
+        static bool try_multi_from_base64(const std::string &b64, Container &result) {
+            return try_multi_from_bytes(utils::base64::decode(b64), result);
+        }
+
+        /**
+         * Parse multiple objects from decoded bytes, e.g. bytes saved to disk earlier.
+         */
+        template <typename Container>
+        static Container multi_from_bytes(const std::string_view bytes) {
             Container result;
-            auto inserter = std::back_inserter(result);
-            auto pack = utils::BinPack(utils::base64::decode(b64));
-            try {
-                const auto count = pack.pop_int<int32_t>();
-                for (auto i = 0; i < count; i++) {
-                    *inserter = Container::value_type::from_bytes(pack.pop_token());
-                }
-            } catch (exception::BytesNotEnough &) {
+            if (!try_multi_from_bytes(bytes, result)) {
                 throw exception::ParseError("failed to parse from bytes to multiple objects");
             }
             return result;
         }
+
+        template <typename Container>
+        static bool try_multi_from_bytes(const std::string_view bytes, Container &result) {
+            CQ_ALLOC_SCOPE(RESULT_DECODE);
+            CQ_TRACE_SPAN(DECODE, "multi_from_bytes");
+            Container parsed;
+            auto inserter = std::back_inserter(parsed);
+            auto pack = utils::BinPack::view(bytes);
+            int32_t count;
+            if (!pack.try_pop_int(count)) {
+                return false;
+            }
+            std::string token;
+            for (auto i = 0; i < count; i++) {
+                typename Container::value_type item;
+                if (!pack.try_pop_token(token) || !Container::value_type::try_from_bytes(token, item)) {
+                    return false;
+                }
+                *inserter = std::move(item);
+            }
+            result = std::move(parsed);
+            return true;
+        }
     };
 
     enum class Sex { MALE = 0, FEMALE = 1, UNKNOWN = 255 };
@@ -51,18 +94,25 @@ namespace cq {
         int32_t age = 0;
 
         static User from_bytes(const std::string &bytes) {
-            auto pack = utils::BinPack(bytes);
             User stranger;
-            try {
-                stranger.user_id = pack.pop_int<int64_t>();
-                stranger.nickname = pack.pop_string();
-                stranger.sex = static_cast<Sex>(pack.pop_int<int32_t>());
-                stranger.age = pack.pop_int<int32_t>();
-            } catch (exception::BytesNotEnough &) {
+            if (!try_from_bytes(bytes, stranger)) {
                 throw exception::ParseError("failed to parse from bytes to a User object");
             }
             return stranger;
         }
+
+        static bool try_from_bytes(const std::string &bytes, User &result) {
+            auto pack = utils::BinPack(bytes);
+            User stranger;
+            int32_t sex;
+            if (!(pack.try_pop_int(stranger.user_id) && pack.try_pop_string(stranger.nickname) && pack.try_pop_int(sex)
+                  && pack.try_pop_int(stranger.age))) {
+                return false;
+            }
+            stranger.sex = static_cast<Sex>(sex);
+            result = std::move(stranger);
+            return true;
+        }
     };
 
     struct Friend : User {
@@ -75,17 +125,23 @@ namespace cq {
         // int32_t age; // from User, not using
 
         static Friend from_bytes(const std::string &bytes) {
-            auto pack = utils::BinPack(bytes);
             Friend frnd;
-            try {
-                frnd.user_id = pack.pop_int<int64_t>();
-                frnd.nickname = pack.pop_string();
-                frnd.remark = pack.pop_string();
-            } catch (exception::BytesNotEnough &) {
+            if (!try_from_bytes(bytes, frnd)) {
                 throw exception::ParseError("failed to parse from bytes to a Friend object");
             }
             return frnd;
         }
+
+        static bool try_from_bytes(const std::string &bytes, Friend &result) {
+            auto pack = utils::BinPack(bytes);
+            Friend frnd;
+            if (!(pack.try_pop_int(frnd.user_id) && pack.try_pop_string(frnd.nickname)
+                  && pack.try_pop_string(frnd.remark))) {
+                return false;
+            }
+            result = std::move(frnd);
+            return true;
+        }
     };
 
     struct Group {
@@ -97,22 +153,26 @@ namespace cq {
         int32_t max_member_count = 0; // only available with get_group_info()
 
         static Group from_bytes(const std::string &bytes) {
-            auto pack = utils::BinPack(bytes);
             Group group;
-            try {
-                group.group_id = pack.pop_int<int64_t>();
-                group.group_name = pack.pop_string();
-                try {
-                    // optional, since this method should work for both get_group_list() and get_group_info()
-                    group.member_count = pack.pop_int<int32_t>();
-                    group.max_member_count = pack.pop_int<int32_t>();
-                } catch (exception::BytesNotEnough &ignored) {
-                }
-            } catch (exception::BytesNotEnough &) {
+            if (!try_from_bytes(bytes, group)) {
                 throw exception::ParseError("failed to parse from bytes to a Group object");
             }
             return group;
         }
+
+        static bool try_from_bytes(const std::string &bytes, Group &result) {
+            auto pack = utils::BinPack(bytes);
+            Group group;
+            if (!(pack.try_pop_int(group.group_id) && pack.try_pop_string(group.group_name))) {
+                return false;
+            }
+            // optional, since this method should work for both get_group_list() and get_group_info()
+            if (pack.try_pop_int(group.member_count)) {
+                pack.try_pop_int(group.max_member_count);
+            }
+            result = std::move(group);
+            return true;
+        }
     };
 
     struct GroupMember : User {
@@ -135,29 +195,31 @@ namespace cq {
         bool card_changeable = false;
 
         static GroupMember from_bytes(const std::string &bytes) {
-            auto pack = utils::BinPack(bytes);
             GroupMember member;
-            try {
-                member.group_id = pack.pop_int<int64_t>();
-                member.user_id = pack.pop_int<int64_t>();
-                member.nickname = pack.pop_string();
-                member.card = pack.pop_string();
-                member.sex = static_cast<Sex>(pack.pop_int<int32_t>());
-                member.age = pack.pop_int<int32_t>();
-                member.area = pack.pop_string();
-                member.join_time = pack.pop_int<int32_t>();
-                member.last_sent_time = pack.pop_int<int32_t>();
-                member.level = pack.pop_string();
-                member.role = static_cast<GroupRole>(pack.pop_int<int32_t>());
-                member.unfriendly = pack.pop_bool();
-                member.title = pack.pop_string();
-                member.title_expire_time = pack.pop_int<int32_t>();
-                member.card_changeable = pack.pop_bool();
-            } catch (exception::BytesNotEnough &) {
+            if (!try_from_bytes(bytes, member)) {
                 throw exception::ParseError("failed to parse from bytes to a GroupMember object");
             }
             return member;
         }
+
+        static bool try_from_bytes(const std::string &bytes, GroupMember &result) {
+            auto pack = utils::BinPack(bytes);
+            GroupMember member;
+            int32_t sex, role;
+            if (!(pack.try_pop_int(member.group_id) && pack.try_pop_int(member.user_id)
+                  && pack.try_pop_string(member.nickname) && pack.try_pop_string(member.card) && pack.try_pop_int(sex)
+                  && pack.try_pop_int(member.age) && pack.try_pop_string(member.area)
+                  && pack.try_pop_int(member.join_time) && pack.try_pop_int(member.last_sent_time)
+                  && pack.try_pop_string(member.level) && pack.try_pop_int(role) && pack.try_pop_bool(member.unfriendly)
+                  && pack.try_pop_string(member.title) && pack.try_pop_int(member.title_expire_time)
+                  && pack.try_pop_bool(member.card_changeable))) {
+                return false;
+            }
+            member.sex = static_cast<Sex>(sex);
+            member.role = static_cast<GroupRole>(role);
+            result = std::move(member);
+            return true;
+        }
     };
 
     struct Anonymous {
@@ -169,29 +231,48 @@ namespace cq {
         std::string flag; // base64 of the whole Anonymous object
 
         static Anonymous from_bytes(const std::string &bytes) {
-            auto pack = utils::BinPack(bytes);
             Anonymous anonymous;
-            try {
-                anonymous.id = pack.pop_int<int64_t>();
-                anonymous.name = pack.pop_string();
-                anonymous.token = pack.pop_token();
-                // NOTE: we don't initialize "flag" here because it represents the
-                // whole object it will be initialized in the specialized
-                // ObjectHelper::from_base64 function
-            } catch (exception::BytesNotEnough &) {
+            if (!try_from_bytes(bytes, anonymous)) {
                 throw exception::ParseError("failed to parse from bytes to an Anonymous object");
             }
             return anonymous;
         }
+
+        static bool try_from_bytes(const std::string &bytes, Anonymous &result) {
+            auto pack = utils::BinPack(bytes);
+            Anonymous anonymous;
+            if (!(pack.try_pop_int(anonymous.id) && pack.try_pop_string(anonymous.name)
+                  && pack.try_pop_token(anonymous.token))) {
+                return false;
+            }
+            // NOTE: we don't initialize "flag" here because it represents the
+            // whole object it will be initialized in the specialized
+            // ObjectHelper::from_base64 function
+            result = std::move(anonymous);
+            return true;
+        }
     };
 
     template <>
     inline Anonymous ObjectHelper::from_base64<Anonymous>(const std::string &b64) {
+        CQ_ALLOC_SCOPE(RESULT_DECODE);
+        CQ_TRACE_SPAN(DECODE, "from_base64");
         auto anonymous = Anonymous::from_bytes(utils::base64::decode(b64));
         anonymous.flag = b64;
         return anonymous;
     }
 
+    template <>
+    inline bool ObjectHelper::try_from_base64<Anonymous>(const std::string &b64, Anonymous &result) {
+        CQ_ALLOC_SCOPE(RESULT_DECODE);
+        CQ_TRACE_SPAN(DECODE, "from_base64");
+        if (!Anonymous::try_from_bytes(utils::base64::decode(b64), result)) {
+            return false;
+        }
+        result.flag = b64;
+        return true;
+    }
+
     struct File {
         const static size_t MIN_SIZE = 20;
 
@@ -201,17 +282,22 @@ namespace cq {
         int64_t busid = 0;
 
         static File from_bytes(const std::string &bytes) {
-            auto pack = utils::BinPack(bytes);
             File file;
-            try {
-                file.id = pack.pop_string();
-                file.name = pack.pop_string();
-                file.size = pack.pop_int<int64_t>();
-                file.busid = pack.pop_int<int64_t>();
-            } catch (exception::BytesNotEnough &) {
+            if (!try_from_bytes(bytes, file)) {
                 throw exception::ParseError("failed to parse from bytes to a File object");
             }
             return file;
         }
+
+        static bool try_from_bytes(const std::string &bytes, File &result) {
+            auto pack = utils::BinPack(bytes);
+            File file;
+            if (!(pack.try_pop_string(file.id) && pack.try_pop_string(file.name) && pack.try_pop_int(file.size)
+                  && pack.try_pop_int(file.busid))) {
+                return false;
+            }
+            result = std::move(file);
+            return true;
+        }
     };
 } // namespace cq
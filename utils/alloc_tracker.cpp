@@ -0,0 +1,90 @@
+#include "./alloc_tracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+using namespace std;
+
+namespace cq::utils::alloc {
+    static atomic<uint64_t> counts[CATEGORY_COUNT];
+    static atomic<uint64_t> bytes[CATEGORY_COUNT];
+    static atomic<uint64_t> event_count;
+    static thread_local Category current_category = OTHER;
+
+    static const char *const CATEGORY_NAMES[CATEGORY_COUNT] = {
+        "other",
+        "event",
+        "string decode",
+        "message parse",
+        "api encode",
+        "result decode",
+        "handler",
+    };
+
+    Scope::Scope(const Category category) noexcept : previous_(current_category) { current_category = category; }
+
+    Scope::~Scope() noexcept { current_category = previous_; }
+
+    Stats stats(const Category category) noexcept {
+        return {counts[category].load(memory_order_relaxed), bytes[category].load(memory_order_relaxed)};
+    }
+
+    void count_event() noexcept { event_count.fetch_add(1, memory_order_relaxed); }
+
+    string report() {
+        const auto events = max(event_count.load(memory_order_relaxed), uint64_t(1));
+        stringstream ss;
+        ss << "events: " << event_count.load(memory_order_relaxed);
+        for (auto i = 0; i < CATEGORY_COUNT; i++) {
+            const auto s = stats(static_cast<Category>(i));
+            ss << "\n" << CATEGORY_NAMES[i] << ": " << s.count << " allocations ("
+               << static_cast<double>(s.count) / events << "/event), " << s.bytes << " bytes ("
+               << static_cast<double>(s.bytes) / events << "/event)";
+        }
+        return ss.str();
+    }
+
+    void reset() noexcept {
+        for (auto i = 0; i < CATEGORY_COUNT; i++) {
+            counts[i].store(0, memory_order_relaxed);
+            bytes[i].store(0, memory_order_relaxed);
+        }
+        event_count.store(0, memory_order_relaxed);
+    }
+
+#ifdef CQ_TRACK_ALLOCATIONS
+    static void *tracked_malloc(const size_t size) {
+        counts[current_category].fetch_add(1, memory_order_relaxed);
+        bytes[current_category].fetch_add(size, memory_order_relaxed);
+        return malloc(size ? size : 1);
+    }
+#endif
+} // namespace cq::utils::alloc
+
+#ifdef CQ_TRACK_ALLOCATIONS
+void *operator new(const size_t size) {
+    if (const auto p = cq::utils::alloc::tracked_malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](const size_t size) { return operator new(size); }
+
+void *operator new(const size_t size, const std::nothrow_t &) noexcept {
+    return cq::utils::alloc::tracked_malloc(size);
+}
+
+void *operator new[](const size_t size, const std::nothrow_t &) noexcept {
+    return cq::utils::alloc::tracked_malloc(size);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+#endif
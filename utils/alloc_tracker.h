@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../common.h"
+
+/**
+ * Allocation tracking, enabled by defining CQ_TRACK_ALLOCATIONS for the whole build.
+ *
+ * When enabled, the global operator new is replaced to count allocations and bytes, attributed to the
+ * category of the innermost CQ_ALLOC_SCOPE on the current thread. Without the macro, scopes compile to nothing.
+ */
+
+namespace cq::utils::alloc {
+    enum Category {
+        OTHER,
+        EVENT, // constructing event objects in the exported event functions
+        STRING_DECODE, // string_from_coolq
+        MESSAGE_PARSE, // Message(const std::string &)
+        API_ENCODE, // string_to_coolq(_arg), for API arguments
+        RESULT_DECODE, // parsing objects returned by the API
+        HANDLER, // user event handlers
+        CATEGORY_COUNT,
+    };
+
+    struct Stats {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+    };
+
+    class Scope {
+    public:
+        explicit Scope(Category category) noexcept;
+        ~Scope() noexcept;
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Category previous_;
+    };
+
+    Stats stats(Category category) noexcept;
+
+    /**
+     * Count a dispatched event, for the per-event averages in report().
+     */
+    void count_event() noexcept;
+
+    /**
+     * Get a human readable report of all categories, with per-event averages.
+     */
+    std::string report();
+
+    void reset() noexcept;
+} // namespace cq::utils::alloc
+
+#ifdef CQ_TRACK_ALLOCATIONS
+#define CQ_ALLOC_SCOPE(category) ::cq::utils::alloc::Scope __cq_alloc_scope(::cq::utils::alloc::category)
+#define CQ_ALLOC_COUNT_EVENT() ::cq::utils::alloc::count_event()
+#else
+#define CQ_ALLOC_SCOPE(category)
+#define CQ_ALLOC_COUNT_EVENT()
+#endif
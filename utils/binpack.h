@@ -2,6 +2,8 @@
 
 #include "../common.h"
 
+#include <string_view>
+
 #include "../exception.h"
 #include "./string.h"
 
@@ -16,55 +18,135 @@ namespace cq::exception {
 namespace cq::utils {
     class BinPack {
     public:
-        BinPack() : bytes_(""), curr_(0) {}
-        explicit BinPack(const std::string &b) : bytes_(b), curr_(0) {}
+        BinPack() : curr_(0) {}
+        explicit BinPack(const std::string &b) : owned_(b), curr_(0) {}
+
+        /**
+         * Read the given bytes in place instead of copying them, e.g. from a mapped file.
+         * The bytes must outlive the returned BinPack.
+         */
+        static BinPack view(const std::string_view b) {
+            BinPack pack;
+            pack.view_ = b;
+            return pack;
+        }
 
-        size_t size() const noexcept { return bytes_.size() - curr_; }
+        size_t size() const noexcept { return bytes().size() - curr_; }
         bool empty() const noexcept { return size() == 0; }
 
+        /**
+         * The try_pop_* functions return false instead of throwing when there aren't enough bytes,
+         * in which case nothing is consumed.
+         */
         template <typename IntType>
-        IntType pop_int() noexcept(false) {
+        bool try_pop_int(IntType &result) noexcept {
             constexpr auto size = sizeof(IntType);
-            check_enough(size);
+            if (this->size() < size) {
+                return false;
+            }
 
-            auto s = bytes_.substr(curr_, size);
+            const auto begin = bytes().data() + curr_;
+            char buf[size];
+            std::reverse_copy(begin, begin + size, buf);
             curr_ += size;
-            std::reverse(s.begin(), s.end());
+            memcpy(static_cast<void *>(&result), buf, size);
+            return true;
+        }
+
+        bool try_pop_string(std::string &result) {
+            int16_t len;
+            if (!try_pop_int(len)) {
+                return false;
+            }
+            if (len == 0) {
+                result.clear();
+                return true;
+            }
+            if (len < 0 || size() < static_cast<size_t>(len)) {
+                curr_ -= sizeof(len);
+                return false;
+            }
+            result = string_from_coolq(std::string(bytes().substr(curr_, len)));
+            curr_ += len;
+            return true;
+        }
+
+        bool try_pop_bytes(const size_t len, std::string &result) {
+            if (size() < len) {
+                return false;
+            }
+            result = bytes().substr(curr_, len);
+            curr_ += len;
+            return true;
+        }
 
+        bool try_pop_token(std::string &result) {
+            int16_t len;
+            if (!try_pop_int(len)) {
+                return false;
+            }
+            if (len < 0 || !try_pop_bytes(len, result)) {
+                curr_ -= sizeof(len);
+                return false;
+            }
+            return true;
+        }
+
+        bool try_pop_bool(bool &result) noexcept {
+            int32_t value;
+            if (!try_pop_int(value)) {
+                return false;
+            }
+            result = static_cast<bool>(value);
+            return true;
+        }
+
+        template <typename IntType>
+        IntType pop_int() noexcept(false) {
             IntType result;
-            memcpy(static_cast<void *>(&result), s.data(), size);
+            if (!try_pop_int(result)) {
+                throw exception::BytesNotEnough(size(), sizeof(IntType));
+            }
             return result;
         }
 
         std::string pop_string() noexcept(false) {
-            const auto len = pop_int<int16_t>();
-            if (len == 0) {
-                return std::string();
+            std::string result;
+            if (!try_pop_string(result)) {
+                throw exception::BytesNotEnough(size(), sizeof(int16_t));
             }
-            check_enough(len);
-            auto result = string_from_coolq(bytes_.substr(curr_, len));
-            curr_ += len;
             return result;
         }
 
         std::string pop_bytes(const size_t len) noexcept(false) {
-            auto result = bytes_.substr(curr_, len);
-            curr_ += len;
+            std::string result;
+            if (!try_pop_bytes(len, result)) {
+                throw exception::BytesNotEnough(size(), len);
+            }
             return result;
         }
 
-        std::string pop_token() noexcept(false) { return pop_bytes(pop_int<int16_t>()); }
+        std::string pop_token() noexcept(false) {
+            std::string result;
+            if (!try_pop_token(result)) {
+                throw exception::BytesNotEnough(size(), sizeof(int16_t));
+            }
+            return result;
+        }
 
-        bool pop_bool() noexcept(false) { return static_cast<bool>(pop_int<int32_t>()); }
+        bool pop_bool() noexcept(false) {
+            bool result;
+            if (!try_pop_bool(result)) {
+                throw exception::BytesNotEnough(size(), sizeof(int32_t));
+            }
+            return result;
+        }
 
     private:
-        std::string bytes_;
+        std::string owned_;
+        std::string_view view_; // set only by view(), so that copies of an owning BinPack stay valid
         size_t curr_;
 
-        void check_enough(const size_t needed) const noexcept(false) {
-            if (size() < needed) {
-                throw exception::BytesNotEnough(size(), needed);
-            }
-        }
+        std::string_view bytes() const noexcept { return view_.data() ? view_ : std::string_view(owned_); }
     };
 } // namespace cq::utils
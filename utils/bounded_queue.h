@@ -0,0 +1,146 @@
+#pragma once
+
+#include "../common.h"
+
+#include <atomic>
+#include <optional>
+
+namespace cq::utils {
+    inline size_t __round_up_pow2(const size_t n) {
+        size_t size = 2;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    /**
+     * A bounded lock-free queue for exactly one producer thread and one consumer thread.
+     * The capacity is rounded up to a power of 2.
+     */
+    template <typename T>
+    class SpscQueue {
+    public:
+        explicit SpscQueue(const size_t capacity) : slots_(__round_up_pow2(capacity)), mask_(slots_.size() - 1) {}
+
+        SpscQueue(const SpscQueue &) = delete;
+        SpscQueue &operator=(const SpscQueue &) = delete;
+
+        /**
+         * Move the item into the queue, or leave it untouched and return false if the queue is full.
+         */
+        bool try_push(T &item) {
+            const auto tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+                return false;
+            }
+            slots_[tail & mask_].emplace(std::move(item));
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T &item) {
+            const auto head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            auto &slot = slots_[head & mask_];
+            item = std::move(*slot);
+            slot.reset();
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        size_t size() const noexcept {
+            return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed);
+        }
+
+        size_t capacity() const noexcept { return slots_.size(); }
+
+    private:
+        std::vector<std::optional<T>> slots_;
+        size_t mask_;
+        alignas(64) std::atomic<size_t> head_{0};
+        alignas(64) std::atomic<size_t> tail_{0};
+    };
+
+    /**
+     * A bounded lock-free queue for any number of producer and consumer threads (Dmitry Vyukov's algorithm).
+     * The capacity is rounded up to a power of 2.
+     */
+    template <typename T>
+    class MpmcQueue {
+    public:
+        explicit MpmcQueue(const size_t capacity) : cells_(__round_up_pow2(capacity)), mask_(cells_.size() - 1) {
+            for (size_t i = 0; i < cells_.size(); i++) {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        MpmcQueue(const MpmcQueue &) = delete;
+        MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+        /**
+         * Move the item into the queue, or leave it untouched and return false if the queue is full.
+         */
+        bool try_push(T &item) {
+            auto pos = tail_.load(std::memory_order_relaxed);
+            while (true) {
+                auto &cell = cells_[pos & mask_];
+                const auto seq = cell.sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.data.emplace(std::move(item));
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false; // full
+                } else {
+                    pos = tail_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool try_pop(T &item) {
+            auto pos = head_.load(std::memory_order_relaxed);
+            while (true) {
+                auto &cell = cells_[pos & mask_];
+                const auto seq = cell.sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        item = std::move(*cell.data);
+                        cell.data.reset();
+                        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false; // empty
+                } else {
+                    pos = head_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        size_t size() const noexcept {
+            const auto tail = tail_.load(std::memory_order_relaxed);
+            const auto head = head_.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+
+        size_t capacity() const noexcept { return cells_.size(); }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            std::optional<T> data;
+        };
+
+        std::vector<Cell> cells_;
+        size_t mask_;
+        alignas(64) std::atomic<size_t> head_{0};
+        alignas(64) std::atomic<size_t> tail_{0};
+    };
+} // namespace cq::utils
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../common.h"
+
+#include <cstring>
+
+namespace cq::utils {
+    namespace detail {
+        constexpr uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+        constexpr uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+        constexpr uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+        constexpr uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+        constexpr uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+        inline uint64_t rotl64(const uint64_t x, const int r) { return (x << r) | (x >> (64 - r)); }
+
+        inline uint64_t read64(const unsigned char *p) {
+            uint64_t v;
+            memcpy(&v, p, sizeof(v)); // little endian, as on x86
+            return v;
+        }
+
+        inline uint32_t read32(const unsigned char *p) {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint64_t xxh64_round(uint64_t acc, const uint64_t input) {
+            acc += input * XXH_PRIME64_2;
+            acc = rotl64(acc, 31);
+            return acc * XXH_PRIME64_1;
+        }
+
+        inline uint64_t xxh64_merge_round(uint64_t acc, const uint64_t val) {
+            acc ^= xxh64_round(0, val);
+            return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+        }
+    } // namespace detail
+
+    /**
+     * XXH64 hash of a byte sequence.
+     */
+    inline uint64_t xxhash64(const void *data, const size_t len, const uint64_t seed = 0) {
+        using namespace detail;
+
+        auto p = static_cast<const unsigned char *>(data);
+        const auto end = p + len;
+        uint64_t h;
+
+        if (len >= 32) {
+            auto v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+            auto v2 = seed + XXH_PRIME64_2;
+            auto v3 = seed;
+            auto v4 = seed - XXH_PRIME64_1;
+            const auto limit = end - 32;
+            do {
+                v1 = xxh64_round(v1, read64(p));
+                v2 = xxh64_round(v2, read64(p + 8));
+                v3 = xxh64_round(v3, read64(p + 16));
+                v4 = xxh64_round(v4, read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+            h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+            h = xxh64_merge_round(h, v1);
+            h = xxh64_merge_round(h, v2);
+            h = xxh64_merge_round(h, v3);
+            h = xxh64_merge_round(h, v4);
+        } else {
+            h = seed + XXH_PRIME64_5;
+        }
+
+        h += static_cast<uint64_t>(len);
+
+        for (; p + 8 <= end; p += 8) {
+            h ^= xxh64_round(0, read64(p));
+            h = rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        }
+        if (p + 4 <= end) {
+            h ^= static_cast<uint64_t>(read32(p)) * XXH_PRIME64_1;
+            h = rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+            p += 4;
+        }
+        for (; p < end; p++) {
+            h ^= (*p) * XXH_PRIME64_5;
+            h = rotl64(h, 11) * XXH_PRIME64_1;
+        }
+
+        h ^= h >> 33;
+        h *= XXH_PRIME64_2;
+        h ^= h >> 29;
+        h *= XXH_PRIME64_3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    inline uint64_t xxhash64(const std::string &str, const uint64_t seed = 0) {
+        return xxhash64(str.data(), str.size(), seed);
+    }
+
+    /**
+     * Mix a 64-bit integer into a well distributed hash (the finalizer of SplitMix64).
+     */
+    inline uint64_t mix64(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return x;
+    }
+} // namespace cq::utils
@@ -0,0 +1,88 @@
+#include "./mmap.h"
+
+#include "./string.h"
+
+using namespace std;
+
+namespace cq::utils {
+    MappedFile::MappedFile(const string &path, const Mode mode, const size_t size) {
+        const auto writable = mode == READ_WRITE;
+        const auto file = CreateFileW(s2ws(path).c_str(),
+                                      writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                                      // let writers replace the file while it's mapped, e.g. SnapshotStore
+                                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                      nullptr,
+                                      writable ? OPEN_ALWAYS : OPEN_EXISTING,
+                                      FILE_ATTRIBUTE_NORMAL,
+                                      nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw exception::RuntimeError("failed to open file " + path);
+        }
+        file_ = file;
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_, &file_size)) {
+            close();
+            throw exception::RuntimeError("failed to get the size of file " + path);
+        }
+        size_ = static_cast<size_t>(file_size.QuadPart);
+        if (writable && size_ < size) {
+            size_ = size;
+        }
+
+        if (size_ == 0) {
+            return; // an empty file can't be mapped, and there is nothing to map anyway
+        }
+
+        const auto size64 = static_cast<uint64_t>(size_);
+        mapping_ = CreateFileMappingW(file_,
+                                      nullptr,
+                                      writable ? PAGE_READWRITE : PAGE_READONLY,
+                                      static_cast<DWORD>(size64 >> 32),
+                                      static_cast<DWORD>(size64 & 0xFFFFFFFF),
+                                      nullptr);
+        if (!mapping_) {
+            close();
+            throw exception::RuntimeError("failed to map file " + path);
+        }
+
+        data_ = static_cast<char *>(MapViewOfFile(mapping_, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size_));
+        if (!data_) {
+            close();
+            throw exception::RuntimeError("failed to map file " + path);
+        }
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            close();
+            swap(file_, other.file_);
+            swap(mapping_, other.mapping_);
+            swap(data_, other.data_);
+            swap(size_, other.size_);
+        }
+        return *this;
+    }
+
+    void MappedFile::flush(const size_t offset, const size_t len) const {
+        if (data_ && offset < size_) {
+            FlushViewOfFile(data_ + offset, min(len, size_ - offset));
+        }
+    }
+
+    void MappedFile::close() noexcept {
+        if (data_) {
+            UnmapViewOfFile(data_);
+            data_ = nullptr;
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+            mapping_ = nullptr;
+        }
+        if (file_) {
+            CloseHandle(file_);
+            file_ = nullptr;
+        }
+        size_ = 0;
+    }
+} // namespace cq::utils
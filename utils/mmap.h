@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../common.h"
+
+#include "../exception.h"
+
+namespace cq::utils {
+    /**
+     * A file mapped into memory.
+     */
+    class MappedFile {
+    public:
+        enum Mode { READ, READ_WRITE };
+
+        MappedFile() = default;
+
+        /**
+         * Map a file. In READ_WRITE mode, the file is created if not exists,
+         * and extended to at least "size" bytes before mapping.
+         */
+        explicit MappedFile(const std::string &path, Mode mode = READ, size_t size = 0) noexcept(false);
+
+        ~MappedFile() { close(); }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+        MappedFile &operator=(MappedFile &&other) noexcept;
+
+        bool is_open() const noexcept { return file_ != nullptr; }
+        const char *data() const noexcept { return data_; }
+        char *data() noexcept { return data_; }
+        size_t size() const noexcept { return size_; }
+
+        /**
+         * Write dirty pages in the given range back to disk.
+         */
+        void flush(size_t offset, size_t len) const;
+
+        void close() noexcept;
+
+    private:
+        HANDLE file_ = nullptr;
+        HANDLE mapping_ = nullptr;
+        char *data_ = nullptr;
+        size_t size_ = 0;
+    };
+} // namespace cq::utils
@@ -1,9 +1,12 @@
 #include "./string.h"
 
 #include <iconv.h>
+#include <cerrno>
 #include <codecvt>
 
 #include "../app.h"
+#include "../trace.h"
+#include "./alloc_tracker.h"
 #include "./memory.h"
 
 using namespace std;
@@ -82,11 +85,82 @@ namespace cq::utils {
     }
 
     string string_to_coolq(const string &str) {
+        CQ_ALLOC_SCOPE(API_ENCODE);
         // call CoolQ API
         return string_encode(str, "gb18030");
     }
 
+    static bool is_ascii(const string &str) noexcept {
+        unsigned char bits = 0;
+        for (const auto c : str) {
+            bits |= static_cast<unsigned char>(c);
+        }
+        return (bits & 0x80) == 0;
+    }
+
+    const char *string_to_coolq_arg(const string &str) {
+        if (is_ascii(str)) {
+            return str.c_str(); // ASCII is the same in GB18030
+        }
+
+        CQ_ALLOC_SCOPE(API_ENCODE);
+        static const size_t MAX_RETAINED_SIZE = 64 * 1024;
+
+        struct Arena {
+            iconv_t cd = iconv_open("gb18030", "utf-8");
+            string buffers[COOLQ_ARG_BUFFER_COUNT];
+            size_t next = 0;
+
+            ~Arena() {
+                if (cd != reinterpret_cast<iconv_t>(-1)) {
+                    iconv_close(cd);
+                }
+            }
+        };
+        static thread_local Arena arena;
+
+        auto &buffer = arena.buffers[arena.next];
+        arena.next = (arena.next + 1) % COOLQ_ARG_BUFFER_COUNT;
+
+        // a character takes at most twice as many bytes in GB18030 as in UTF-8 (e.g. 2-byte "ß" takes 4)
+        const auto needed = str.size() * 2 + 1;
+        if (buffer.capacity() > MAX_RETAINED_SIZE && needed <= MAX_RETAINED_SIZE) {
+            string().swap(buffer); // don't hold a huge buffer forever for a single huge message
+        }
+        buffer.resize(needed);
+
+        if (arena.cd == reinterpret_cast<iconv_t>(-1)) {
+            return str.c_str(); // no converter at all, better pass the UTF-8 bytes than nothing
+        }
+        iconv(arena.cd, nullptr, nullptr, nullptr, nullptr); // reset the state
+
+        auto in = const_cast<char *>(str.data());
+        auto in_bytes_left = str.size();
+        size_t used = 0;
+        while (true) {
+            auto out = buffer.data() + used;
+            auto out_bytes_left = buffer.size() - 1 - used;
+            const auto ret = iconv(arena.cd, &in, &in_bytes_left, &out, &out_bytes_left);
+            used = out - buffer.data();
+            if (ret != static_cast<size_t>(-1)) {
+                break;
+            }
+            if (errno == E2BIG || out_bytes_left == 0) {
+                buffer.resize(buffer.size() * 2); // shouldn't happen given the size above, but never cut the string
+                continue;
+            }
+            // invalid or truncated UTF-8, replace the byte instead of losing the whole string
+            buffer[used++] = '?';
+            in++;
+            in_bytes_left--;
+        }
+        buffer.resize(used);
+        return buffer.c_str();
+    }
+
     string string_from_coolq(const string &str) {
+        CQ_ALLOC_SCOPE(STRING_DECODE);
+        CQ_TRACE_SPAN(DECODE, "string_from_coolq");
         // handle CoolQ event or data
         auto result = string_decode(str, "gb18030");
 
@@ -104,8 +178,13 @@ namespace cq::utils {
                     u32_str.append({codepoint});
                 }
 
-                const auto p = reinterpret_cast<const uint32_t *>(u32_str.data());
-                wstring_convert<codecvt_utf8<uint32_t>, uint32_t> conv;
+#ifdef _MSC_VER
+                using CodePoint = uint32_t; // VC++ doesn't export the char32_t specialization of codecvt_utf8
+#else
+                using CodePoint = char32_t;
+#endif
+                const auto p = reinterpret_cast<const CodePoint *>(u32_str.data());
+                wstring_convert<codecvt_utf8<CodePoint>, CodePoint> conv;
                 return conv.to_bytes(p, p + u32_str.size());
             });
 
@@ -26,6 +26,16 @@ namespace cq::utils {
     std::string string_decode(const std::string &b, const std::string &encoding, float capability_factor = 2.0f);
 
     std::string string_to_coolq(const std::string &str);
+
+    /**
+     * Encode an API argument for CoolQ into one of a few reused thread-local buffers, and return a pointer to it.
+     * ASCII-only strings need no conversion, so their own buffer is returned without copying.
+     * The pointer is valid until COOLQ_ARG_BUFFER_COUNT more calls on the same thread,
+     * which is enough for the arguments of a single API call, but not for keeping it around.
+     */
+    const char *string_to_coolq_arg(const std::string &str);
+
+    static const size_t COOLQ_ARG_BUFFER_COUNT = 4;
     std::string string_from_coolq(const std::string &str);
 
     std::string ws2s(const std::wstring &ws);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "../common.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace cq::utils {
+    /**
+     * A fixed number of threads running posted tasks in FIFO order.
+     */
+    class ThreadPool {
+    public:
+        explicit ThreadPool(const size_t thread_count) {
+            for (size_t i = 0; i < std::max(thread_count, size_t(1)); i++) {
+                threads_.emplace_back([this] { run(); });
+            }
+        }
+
+        ~ThreadPool() { stop(); }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        void post(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_) {
+                    return;
+                }
+                tasks_.push_back(std::move(task));
+            }
+            cv_.notify_one();
+        }
+
+        /**
+         * Run the tasks already posted, and then join all threads.
+         */
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            cv_.notify_all();
+            for (auto &t : threads_) {
+                if (t.joinable()) {
+                    t.join();
+                }
+            }
+            threads_.clear();
+        }
+
+    private:
+        std::vector<std::thread> threads_;
+        std::deque<std::function<void()>> tasks_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stopping_ = false;
+
+        void run() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                    if (tasks_.empty()) {
+                        return; // stopping, and nothing left
+                    }
+                    task = std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+                try {
+                    task();
+                } catch (...) {
+                    // a failed task must not take the worker down
+                }
+            }
+        }
+    };
+} // namespace cq::utils
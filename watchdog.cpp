@@ -0,0 +1,276 @@
+#include "./watchdog.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "./logging.h"
+
+using namespace std;
+
+namespace cq::watchdog {
+    Options options;
+
+    static const size_t SLOT_COUNT = 64;
+    static const uintptr_t READING = 1; // set in Slot::watch while the watchdog copies from the Watch
+
+    /**
+     * The handler running on one thread, owned by that thread until it exits.
+     */
+    struct Slot {
+        atomic<bool> owned{false};
+        atomic<int64_t> start{0}; // steady clock milliseconds, 0 when idle
+        atomic<uintptr_t> watch{0}; // the current Watch, with READING set while the watchdog reads it
+
+        // only touched by the watchdog thread
+        int64_t reported_start = 0;
+        uint64_t reported_entry = 0;
+    };
+
+    static Slot slots[SLOT_COUNT];
+    static atomic<size_t> slot_count{0}; // slots ever claimed, the watchdog polls these
+
+    static mutex log_mutex;
+    static deque<pair<uint64_t, SlowHandler>> entries; // (entry id, entry)
+    static uint64_t next_entry_id = 1;
+
+    static mutex thread_mutex;
+    static condition_variable thread_cv;
+    static thread watchdog_thread;
+    static atomic<bool> running{false};
+
+    // for measuring how long handlers run, unaffected by adjustments of the system clock
+    static int64_t now_ms() {
+        const auto now =
+            chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+        return now ? now : 1;
+    }
+
+    /**
+     * The slot of the current thread, which is given back when the thread exits,
+     * so that short-lived threads (e.g. of execute_batch) don't use up the slots.
+     */
+    struct ThreadSlot {
+        Slot *slot = nullptr;
+        bool claimed = false;
+
+        ~ThreadSlot() {
+            if (slot) {
+                slot->owned.store(false, memory_order_release);
+            }
+        }
+    };
+
+    static Slot *claim_slot() {
+        static thread_local ThreadSlot thread_slot;
+        if (!thread_slot.claimed) {
+            thread_slot.claimed = true;
+            for (auto &slot : slots) {
+                auto owned = false;
+                if (slot.owned.compare_exchange_strong(owned, true, memory_order_acquire)) {
+                    thread_slot.slot = &slot;
+                    const auto count = static_cast<size_t>(&slot - slots) + 1;
+                    auto seen = slot_count.load(memory_order_relaxed);
+                    while (seen < count && !slot_count.compare_exchange_weak(seen, count, memory_order_relaxed)) {
+                    }
+                    break;
+                }
+            } // if all are taken, leave this thread alone
+        }
+        return thread_slot.slot;
+    }
+
+    static void run();
+
+    static void ensure_started() {
+        if (running.load(memory_order_acquire)) {
+            return;
+        }
+        lock_guard<mutex> lock(thread_mutex);
+        if (!running.load(memory_order_relaxed)) {
+            running.store(true, memory_order_release);
+            watchdog_thread = thread(run);
+        }
+    }
+
+    Watch::Watch(const char *handler, const Target &target, const int32_t message_id,
+                 const string_view raw_message) noexcept
+        : handler_(handler), target_(&target), message_id_(message_id), raw_message_(raw_message) {
+        if (!options.enabled) {
+            return;
+        }
+        const auto slot = claim_slot();
+        if (!slot || slot->watch.load(memory_order_relaxed)) {
+            return; // no slot, or nested in another Watch
+        }
+        try {
+            ensure_started();
+        } catch (...) {
+            return;
+        }
+        slot_ = slot;
+        slot_->watch.store(reinterpret_cast<uintptr_t>(this), memory_order_release);
+        slot_->start.store(now_ms(), memory_order_relaxed);
+    }
+
+    Watch::~Watch() noexcept {
+        if (!slot_) {
+            return;
+        }
+        slot_->start.store(0, memory_order_relaxed);
+        const auto self = reinterpret_cast<uintptr_t>(this);
+        auto expected = self;
+        while (!slot_->watch.compare_exchange_weak(expected, 0, memory_order_release, memory_order_relaxed)) {
+            if (expected == (self | READING)) {
+                this_thread::yield(); // the watchdog is copying the details of this slow handler
+            }
+            expected = self;
+        }
+    }
+
+    /**
+     * Copy the details of the handler running in a slot, or return false if it is not the one started at "start".
+     */
+    bool read_watch(Slot &slot, const int64_t start, SlowHandler &entry) {
+        auto watch = slot.watch.load(memory_order_relaxed);
+        if (!watch || !slot.watch.compare_exchange_strong(watch, watch | READING, memory_order_acquire)) {
+            return false;
+        }
+        // the Watch can't go away until READING is cleared, but it may be a newer one at the same address
+        const auto ok = slot.start.load(memory_order_relaxed) == start;
+        if (ok) {
+            const auto &w = *reinterpret_cast<const Watch *>(watch);
+            entry.handler = w.handler_;
+            entry.target = *w.target_;
+            entry.message_id = w.message_id_;
+            auto raw_size = min(w.raw_message_.size(), RAW_MESSAGE_SIZE);
+            while (raw_size < w.raw_message_.size() && raw_size > 0 && (w.raw_message_[raw_size] & 0xC0) == 0x80) {
+                raw_size--; // don't cut a UTF-8 character in half
+            }
+            try {
+                entry.raw_message.assign(w.raw_message_.data(), raw_size);
+            } catch (...) {
+            }
+        }
+        slot.watch.store(watch, memory_order_release);
+        return ok;
+    }
+
+    static string describe(const SlowHandler &entry) {
+        string target;
+        if (entry.target.group_id) {
+            target = "group " + to_string(entry.target.group_id.value());
+        } else if (entry.target.discuss_id) {
+            target = "discuss " + to_string(entry.target.discuss_id.value());
+        }
+        if (entry.target.user_id) {
+            target += (target.empty() ? "user " : ", user ") + to_string(entry.target.user_id.value());
+        }
+        auto text = string(entry.handler ? entry.handler : "handler") + " has been running for "
+                    + to_string(entry.elapsed.count()) + " ms, " + target;
+        if (entry.message_id) {
+            text += ", message " + to_string(entry.message_id) + ": " + entry.raw_message;
+        }
+        return text;
+    }
+
+    static void poll() {
+        const auto now = now_ms();
+        const auto threshold = options.threshold.count();
+        const auto count = min(slot_count.load(memory_order_relaxed), SLOT_COUNT);
+        for (size_t i = 0; i < count; i++) {
+            auto &slot = slots[i];
+            const auto start = slot.start.load(memory_order_relaxed);
+
+            if (slot.reported_entry && start != slot.reported_start) {
+                // the reported handler has returned
+                lock_guard<mutex> lock(log_mutex);
+                for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+                    if (it->first == slot.reported_entry) {
+                        it->second.finished = true;
+                        break;
+                    }
+                }
+                slot.reported_entry = 0;
+            }
+
+            if (start == 0 || now - start < threshold) {
+                continue;
+            }
+
+            if (start == slot.reported_start) {
+                lock_guard<mutex> lock(log_mutex);
+                for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+                    if (it->first == slot.reported_entry) {
+                        it->second.elapsed = chrono::milliseconds(now - start);
+                        break;
+                    }
+                }
+                continue;
+            }
+
+            SlowHandler entry;
+            if (!read_watch(slot, start, entry)) {
+                continue;
+            }
+            entry.elapsed = chrono::milliseconds(now - start);
+            // only the reported start time comes from the system clock
+            entry.time = chrono::system_clock::to_time_t(chrono::system_clock::now() - entry.elapsed);
+            slot.reported_start = start;
+
+            if (options.log_to_coolq) {
+                try {
+                    logging::warning("Watchdog", describe(entry));
+                } catch (...) {
+                }
+            }
+
+            lock_guard<mutex> lock(log_mutex);
+            slot.reported_entry = next_entry_id++;
+            entries.emplace_back(slot.reported_entry, std::move(entry));
+            while (entries.size() > max(options.slow_log_size, size_t(1))) {
+                entries.pop_front();
+            }
+        }
+    }
+
+    static void run() {
+        unique_lock<mutex> lock(thread_mutex);
+        while (running.load(memory_order_relaxed)) {
+            lock.unlock();
+            poll();
+            lock.lock();
+            // poll a few times per threshold, so that the elapsed time is not too late
+            const auto interval = max(options.threshold / 4, chrono::milliseconds(10));
+            thread_cv.wait_for(lock, interval, [] { return !running.load(memory_order_relaxed); });
+        }
+    }
+
+    vector<SlowHandler> slow_log() {
+        lock_guard<mutex> lock(log_mutex);
+        vector<SlowHandler> result;
+        result.reserve(entries.size());
+        for (const auto &item : entries) {
+            result.push_back(item.second);
+        }
+        return result;
+    }
+
+    void clear_slow_log() {
+        lock_guard<mutex> lock(log_mutex);
+        entries.clear();
+    }
+
+    void __stop() {
+        {
+            lock_guard<mutex> lock(thread_mutex);
+            if (!running.load(memory_order_relaxed)) {
+                return;
+            }
+            running.store(false, memory_order_release);
+        }
+        thread_cv.notify_all();
+        watchdog_thread.join();
+    }
+} // namespace cq::watchdog
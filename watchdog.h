@@ -0,0 +1,76 @@
+#pragma once
+
+#include "./common.h"
+
+#include <atomic>
+#include <chrono>
+
+#include "./target.h"
+
+/**
+ * A watchdog for slow event handlers.
+ *
+ * Each thread running handlers publishes the start time of the current handler and a pointer to its Watch,
+ * which is all a handler costs. A single watchdog thread polls these slots, and copies the event details
+ * only for handlers running longer than the threshold, into the slow log. A slow handler returning
+ * right at that moment waits for the copy to finish.
+ */
+namespace cq::watchdog {
+    struct Options {
+        bool enabled = false;
+        std::chrono::milliseconds threshold = std::chrono::seconds(1);
+        size_t slow_log_size = 128; // only the latest entries are kept
+        bool log_to_coolq = true; // also write a warning to the CoolQ log
+    };
+
+    extern Options options;
+
+    /**
+     * A handler that has run longer than the threshold.
+     */
+    struct SlowHandler {
+        const char *handler = nullptr; // e.g. "on_group_msg"
+        Target target;
+        int32_t message_id = 0; // 0 for non-message events
+        std::string raw_message; // truncated to RAW_MESSAGE_SIZE bytes
+        std::chrono::milliseconds elapsed{0}; // updated while the handler keeps running
+        bool finished = false; // whether the handler has returned, as of the last poll
+        time_t time = 0; // when the handler started
+    };
+
+    static const size_t RAW_MESSAGE_SIZE = 128;
+
+    std::vector<SlowHandler> slow_log();
+    void clear_slow_log();
+
+    /**
+     * Mark the current thread as running a handler, until destruction.
+     * This is internally used by the event layer, and does nothing when the watchdog is disabled.
+     * A Watch inside another one on the same thread does nothing either, the outer handler is the one reported.
+     * The target and the raw message are referenced, not copied, so they must outlive the Watch.
+     */
+    class Watch {
+    public:
+        Watch(const char *handler, const Target &target, int32_t message_id = 0,
+              std::string_view raw_message = {}) noexcept;
+        ~Watch() noexcept;
+
+        Watch(const Watch &) = delete;
+        Watch &operator=(const Watch &) = delete;
+
+    private:
+        struct Slot *slot_ = nullptr;
+        const char *handler_;
+        const Target *target_;
+        int32_t message_id_;
+        std::string_view raw_message_;
+
+        friend bool read_watch(struct Slot &slot, int64_t start, SlowHandler &entry);
+    };
+
+    /**
+     * Stop the watchdog thread, which is started on demand.
+     * This is internally called when the app is disabled or CoolQ is exiting.
+     */
+    void __stop();
+} // namespace cq::watchdog